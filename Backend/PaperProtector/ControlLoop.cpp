@@ -0,0 +1,307 @@
+#include "ControlLoop.h"
+
+// 静态实例指针初始化
+ControlLoop *ControlLoop::_instance = nullptr;
+
+// 构造函数
+ControlLoop::ControlLoop(SerialPubSub *pubsub, DHT22Sensor *dht,
+                         Heater *heater, FanController *fan)
+    : _pubsub(pubsub),
+      _dht(dht),
+      _heater(heater),
+      _fan(fan),
+      _enabled(false),         // 默认关闭，主机经control/enable显式开启
+      _humiditySetpoint(45.0), // 默认目标湿度45%RH
+      _maxTemperature(50.0),   // 加热安全上限50℃
+      _kp(8.0),
+      _ki(0.2),
+      _kd(4.0),
+      _integral(0.0),
+      _lastHumidity(0.0),
+      _hasLastSample(false),
+      _lastUpdateTime(0),
+      _lastReportTime(0)
+{
+    _instance = this;
+}
+
+// 初始化 - 订阅控制主题
+void ControlLoop::begin()
+{
+    // 订阅control/setpoint主题（设定目标值）
+    _pubsub->subscribe(F("control/setpoint"), setpointCallback);
+
+    // 订阅control/enable主题（使能/禁用闭环）
+    _pubsub->subscribe(F("control/enable"), enableCallback);
+
+    // 订阅control/config主题（PID参数）
+    _pubsub->subscribe(F("control/config"), configCallback);
+
+    publishStatus();
+}
+
+// 循环处理 - 按固定周期执行PID
+void ControlLoop::loop()
+{
+    if (!_enabled)
+    {
+        return;
+    }
+
+    unsigned long now = millis();
+    if (now - _lastUpdateTime < CONTROL_PERIOD_MS)
+    {
+        return;
+    }
+    _lastUpdateTime = now;
+
+    update();
+}
+
+// 执行一个PID周期
+// 误差 = 当前湿度 - 目标湿度（正值表示过湿，需要加大干燥力度）
+// 输出0-255同时驱动加热器和风扇；微分项基于测量值避免设定值阶跃踢动
+void ControlLoop::update()
+{
+    if (!_dht->hasReading())
+    {
+        return;
+    }
+
+    float humidity = _dht->getHumidity();
+    float temperature = _dht->getTemperature();
+
+    float error = humidity - _humiditySetpoint;
+
+    // 积分累计与防饱和限幅
+    _integral += error * _ki;
+    if (_integral > 255.0)
+    {
+        _integral = 255.0;
+    }
+    else if (_integral < 0.0)
+    {
+        _integral = 0.0;
+    }
+
+    // 微分项基于测量值变化
+    float derivative = 0.0;
+    if (_hasLastSample)
+    {
+        derivative = humidity - _lastHumidity;
+    }
+    _lastHumidity = humidity;
+    _hasLastSample = true;
+
+    float output = _kp * error + _integral + _kd * derivative;
+
+    // 超温保护：加热器强制关闭，只留风扇散热
+    if (temperature >= _maxTemperature)
+    {
+        _heater->setPower(0);
+        _fan->setSpeed(255);
+        _pubsub->publish(F("control/error"), F("Over temperature"));
+        return;
+    }
+
+    applyOutput(output);
+
+    // 节流上报控制状态（每5秒）
+    unsigned long now = millis();
+    if (now - _lastReportTime >= 5000)
+    {
+        _lastReportTime = now;
+
+        char errStr[10];
+        char outStr[10];
+        char stateMsg[40];
+        dtostrf(error, 0, 1, errStr);
+        dtostrf(output, 0, 0, outStr);
+        snprintf_P(stateMsg, sizeof(stateMsg), PSTR("error:%s,output:%s"), errStr, outStr);
+        _pubsub->publish(F("control/state"), stateMsg);
+    }
+}
+
+// 将PID输出映射到执行器
+void ControlLoop::applyOutput(float output)
+{
+    if (output < 0.0)
+    {
+        output = 0.0;
+    }
+    else if (output > 255.0)
+    {
+        output = 255.0;
+    }
+
+    int drive = (int)output;
+    _heater->setPower(drive);
+    _fan->setSpeed(drive);
+}
+
+// 使能/禁用闭环控制
+void ControlLoop::setEnabled(bool enabled)
+{
+    _enabled = enabled;
+
+    if (!enabled)
+    {
+        // 禁用时复位PID状态并停止执行器，控制权交还主机
+        _integral = 0.0;
+        _hasLastSample = false;
+        _heater->setPower(0);
+        _fan->setSpeed(0);
+    }
+
+    publishStatus();
+}
+
+bool ControlLoop::isEnabled() const
+{
+    return _enabled;
+}
+
+// 发布当前控制配置和状态
+void ControlLoop::publishStatus()
+{
+    char spStr[10];
+    char statusMsg[48];
+
+    dtostrf(_humiditySetpoint, 0, 1, spStr);
+    snprintf_P(statusMsg, sizeof(statusMsg), PSTR("enabled:%s,setpoint:%s"),
+               _enabled ? "true" : "false", spStr);
+    _pubsub->publish(F("control/status"), statusMsg);
+}
+
+// 发布错误消息
+void ControlLoop::publishError(const char *error)
+{
+    _pubsub->publish(F("control/error"), error);
+}
+
+void ControlLoop::publishError(const __FlashStringHelper *error)
+{
+    _pubsub->publish(F("control/error"), error);
+}
+
+// 设定值回调：格式 "humidity:<value>" 或 "maxtemp:<value>"
+void ControlLoop::setpointCallback(const char *topic, const char *payload)
+{
+    if (_instance == nullptr)
+    {
+        return;
+    }
+
+    if (payload == nullptr || payload[0] == '\0')
+    {
+        _instance->publishError(F("Invalid setpoint format"));
+        return;
+    }
+
+    if (strncmp(payload, "humidity:", 9) == 0)
+    {
+        float value = atof(payload + 9);
+        if (value < 0.0 || value > 100.0)
+        {
+            _instance->publishError(F("Humidity setpoint out of range (0-100)"));
+            return;
+        }
+        _instance->_humiditySetpoint = value;
+        _instance->publishStatus();
+    }
+    else if (strncmp(payload, "maxtemp:", 8) == 0)
+    {
+        float value = atof(payload + 8);
+        if (value < 20.0 || value > 80.0)
+        {
+            _instance->publishError(F("Max temperature out of range (20-80)"));
+            return;
+        }
+        _instance->_maxTemperature = value;
+        _instance->publishStatus();
+    }
+    else
+    {
+        _instance->publishError(F("Unknown setpoint parameter"));
+    }
+}
+
+// 使能回调
+void ControlLoop::enableCallback(const char *topic, const char *payload)
+{
+    if (_instance == nullptr || payload == nullptr)
+    {
+        return;
+    }
+
+    if (strcmp(payload, "on") == 0)
+    {
+        _instance->setEnabled(true);
+    }
+    else if (strcmp(payload, "off") == 0)
+    {
+        _instance->setEnabled(false);
+    }
+    else
+    {
+        _instance->publishError(F("Invalid enable value"));
+    }
+}
+
+// PID参数回调：格式 "kp:<v>"、"ki:<v>" 或 "kd:<v>"
+void ControlLoop::configCallback(const char *topic, const char *payload)
+{
+    if (_instance == nullptr)
+    {
+        return;
+    }
+
+    if (payload == nullptr || payload[0] == '\0')
+    {
+        _instance->publishError(F("Invalid config format"));
+        return;
+    }
+
+    const char *separator = strchr(payload, ':');
+    if (separator == nullptr || separator != payload + 2)
+    {
+        _instance->publishError(F("Invalid config format"));
+        return;
+    }
+
+    float value = atof(separator + 1);
+    if (value < 0.0 || value > 100.0)
+    {
+        _instance->publishError(F("Gain out of range (0-100)"));
+        return;
+    }
+
+    if (strncmp(payload, "kp", 2) == 0)
+    {
+        _instance->_kp = value;
+    }
+    else if (strncmp(payload, "ki", 2) == 0)
+    {
+        _instance->_ki = value;
+        _instance->_integral = 0.0; // 改变积分增益时复位积分
+    }
+    else if (strncmp(payload, "kd", 2) == 0)
+    {
+        _instance->_kd = value;
+    }
+    else
+    {
+        _instance->publishError(F("Unknown config parameter"));
+        return;
+    }
+
+    char kpStr[10];
+    char kiStr[10];
+    char kdStr[10];
+    char configMsg[48];
+    dtostrf(_instance->_kp, 0, 2, kpStr);
+    dtostrf(_instance->_ki, 0, 2, kiStr);
+    dtostrf(_instance->_kd, 0, 2, kdStr);
+    snprintf_P(configMsg, sizeof(configMsg), PSTR("kp:%s,ki:%s,kd:%s"), kpStr, kiStr, kdStr);
+    _instance->_pubsub->publish(F("control/config/status"), configMsg);
+}
@@ -0,0 +1,67 @@
+#ifndef CONTROL_LOOP_H
+#define CONTROL_LOOP_H
+
+#include <Arduino.h>
+#include "SerialPubSub.h"
+#include "DHT22Sensor.h"
+#include "Heater.h"
+#include "FanController.h"
+
+class ControlLoop
+{
+public:
+    // 构造函数
+    ControlLoop(SerialPubSub *pubsub, DHT22Sensor *dht,
+                Heater *heater, FanController *fan);
+
+    // 初始化
+    void begin();
+
+    // 循环处理（按固定周期执行PID计算）
+    void loop();
+
+    // 使能/禁用闭环控制
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+private:
+    SerialPubSub *_pubsub;
+    DHT22Sensor *_dht;
+    Heater *_heater;
+    FanController *_fan;
+
+    // 控制状态
+    bool _enabled;           // 闭环是否使能（默认关闭，主机显式开启）
+    float _humiditySetpoint; // 目标湿度(%RH)
+    float _maxTemperature;   // 加热安全上限(℃)，超过则强制关闭加热器
+
+    // PID参数与状态
+    float _kp;
+    float _ki;
+    float _kd;
+    float _integral;      // 积分累计（带防饱和限幅）
+    float _lastHumidity;  // 上一周期的湿度（微分项基于测量值）
+    bool _hasLastSample;  // 是否已有上一周期样本
+
+    // 执行周期
+    unsigned long _lastUpdateTime;
+    static const unsigned long CONTROL_PERIOD_MS = 1000; // PID周期
+
+    // 状态上报节流
+    unsigned long _lastReportTime;
+
+    // 消息回调处理
+    static void setpointCallback(const char *topic, const char *payload);
+    static void enableCallback(const char *topic, const char *payload);
+    static void configCallback(const char *topic, const char *payload);
+    static ControlLoop *_instance; // 用于静态回调
+
+    // 内部方法
+    void update();
+    void applyOutput(float output);
+    void publishStatus();
+    void publishError(const char *error);
+    void publishError(const __FlashStringHelper *error);
+};
+
+#endif
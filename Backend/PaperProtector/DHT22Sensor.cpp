@@ -1,33 +1,86 @@
 #include "DHT22Sensor.h"
+#include "TelemetryHistory.h"
 
 DHT22Sensor *DHT22Sensor::_instance = nullptr;
 
+#ifdef __AVR__
+
+volatile uint16_t DHT22Sensor::_edgeTimes[DHT22Sensor::DHT_EDGE_MAX];
+volatile uint8_t DHT22Sensor::_edgeCount = 0;
+
+// 数据脚所在端口的引脚变化中断向量
+// DHT_PIN为8（PORTB/PCINT0组）；换到其他端口的引脚时需同步改向量
+ISR(PCINT0_vect)
+{
+    DHT22Sensor::handlePinChange();
+}
+
+// ISR：只记录下降沿的时间戳，解码完全留给loop()
+// 单次进入只有一次端口读和一次micros()，不影响步进脉冲定时
+void DHT22Sensor::handlePinChange()
+{
+    if (_instance == nullptr)
+    {
+        return;
+    }
+    if ((*_instance->_dhtPinReg & _instance->_dhtBitMask) != 0)
+    {
+        return; // 上升沿不关心
+    }
+    if (_edgeCount < DHT_EDGE_MAX)
+    {
+        _edgeTimes[_edgeCount++] = (uint16_t)micros();
+    }
+}
+
+#endif // __AVR__
+
 DHT22Sensor::DHT22Sensor(SerialPubSub *pubsub, int dhtPin)
     : _pubsub(pubsub),
       _dhtPin(dhtPin),
+      _history(nullptr),
       _lastReadTime(0),
       _readInterval(200), // 200ms读取间隔，更快响应
       _startTime(0),
       _lastTemperature(NAN),
       _lastHumidity(NAN),
-      _emaTemperature(NAN),
-      _emaHumidity(NAN),
+      _emaTemperatureFx(0),
+      _emaHumidityFx(0),
       _emaInitialized(false),
-      _emaAlpha(0.3) // 0.3平滑系数：平衡响应速度和稳定性
+      _emaAlphaFx(fixedFromFloat(0.3)), // 0.3平滑系数：平衡响应速度和稳定性
+      _publishEpsilon(0.2),    // 变化超过0.2(℃/%RH)才发布
+      _keepaliveInterval(5000), // 5秒保活，保证主机数据不过期
+      _lastPublishTime(0),
+      _publishedTemperature(NAN),
+      _publishedHumidity(NAN),
+      _hasPublished(false)
 {
     _instance = this;
     _dht = new DHT(_dhtPin, DHT22);
+#ifdef __AVR__
+    _captureState = DHT_CAPTURE_IDLE;
+    _captureStartUs = 0;
+    _dhtPinReg = nullptr;
+    _dhtBitMask = 0;
+#endif
 }
 
 void DHT22Sensor::begin()
 {
     _dht->begin();
 
-    _pubsub->subscribe("dht/query", queryCallback);
+#ifdef __AVR__
+    // 一次性解析数据脚到输入寄存器和位掩码，ISR里直接读端口
+    _dhtPinReg = portInputRegister(digitalPinToPort(_dhtPin));
+    _dhtBitMask = digitalPinToBitMask(_dhtPin);
+#endif
+
+    _pubsub->subscribe(F("dht/query"), queryCallback);
+    _pubsub->subscribe(F("dht/config"), configCallback);
 
     _startTime = millis();
 
-    _pubsub->publish("dht/status", "initializing");
+    _pubsub->publish(F("dht/status"), F("initializing"));
 }
 
 void DHT22Sensor::loop()
@@ -39,9 +92,14 @@ void DHT22Sensor::loop()
         return;
     }
 
+#ifdef __AVR__
+    // 先推进进行中的捕获（起始脉冲结束/捕获完成的判定都在这里）
+    runCapture();
+#endif
+
     if (_lastReadTime == 0)
     {
-        _pubsub->publish("dht/status", "ready");
+        _pubsub->publish(F("dht/status"), F("ready"));
         readAndPublish();
         _lastReadTime = currentTime;
         return;
@@ -54,33 +112,183 @@ void DHT22Sensor::loop()
     }
 }
 
+// 获取平滑后的温度（无有效读数时为NAN）
+float DHT22Sensor::getTemperature() const
+{
+    return _lastTemperature;
+}
+
+// 获取平滑后的湿度（无有效读数时为NAN）
+float DHT22Sensor::getHumidity() const
+{
+    return _lastHumidity;
+}
+
+// 是否已有有效读数
+bool DHT22Sensor::hasReading() const
+{
+    return !isnan(_lastTemperature) && !isnan(_lastHumidity);
+}
+
+void DHT22Sensor::setHistory(TelemetryHistory *history)
+{
+    _history = history;
+}
+
+#ifdef __AVR__
+
+// 触发一次中断捕获读取：拉低总线开始起始脉冲，
+// 后续阶段由loop()里的runCapture()非阻塞推进
+void DHT22Sensor::startCapture()
+{
+    if (_captureState != DHT_CAPTURE_IDLE)
+    {
+        return; // 上一次捕获还在进行
+    }
+
+    pinMode(_dhtPin, OUTPUT);
+    digitalWrite(_dhtPin, LOW);
+    _captureState = DHT_CAPTURE_START;
+    _captureStartUs = micros();
+}
+
+// 推进捕获状态机（loop()每次调用）
+// 各阶段只检查时间/计数条件，传感器应答期间主循环完全自由
+void DHT22Sensor::runCapture()
+{
+    switch (_captureState)
+    {
+    case DHT_CAPTURE_IDLE:
+        break;
+
+    case DHT_CAPTURE_START:
+        // 起始低脉冲保持够时长后释放总线，打开引脚变化中断
+        if (micros() - _captureStartUs >= DHT_START_PULSE_US)
+        {
+            _edgeCount = 0;
+            pinMode(_dhtPin, INPUT_PULLUP);
+            *digitalPinToPCICR(_dhtPin) |=
+                _BV(digitalPinToPCICRbit(_dhtPin));
+            *digitalPinToPCMSK(_dhtPin) |=
+                _BV(digitalPinToPCMSKbit(_dhtPin));
+            _captureState = DHT_CAPTURE_EDGES;
+            _captureStartUs = micros();
+        }
+        break;
+
+    case DHT_CAPTURE_EDGES:
+        // 应答+40位全程约5ms；集齐42个下降沿或超时后关中断解码
+        if (_edgeCount >= 42 ||
+            micros() - _captureStartUs > DHT_CAPTURE_TIMEOUT_US)
+        {
+            *digitalPinToPCMSK(_dhtPin) &=
+                ~_BV(digitalPinToPCMSKbit(_dhtPin));
+            _captureState = DHT_CAPTURE_IDLE;
+            decodeCapture();
+        }
+        break;
+    }
+}
+
+// 从捕获的下降沿时间戳解码40位数据
+// 下降沿序列：应答脉冲2个 + 每位结束1个，位周期为相邻下降沿间隔：
+// ~78µs为0、~120µs为1，用110µs做判别阈值；末5字节含校验和
+void DHT22Sensor::decodeCapture()
+{
+    uint8_t count = _edgeCount;
+    if (count < 42)
+    {
+        _pubsub->publish(F("dht/error"), F("Capture timeout"));
+        return;
+    }
+
+    // 取末尾41个下降沿构成40个位周期（应答沿自然被排除在外）
+    uint8_t data[5] = {0, 0, 0, 0, 0};
+    uint8_t start = count - 41;
+    for (uint8_t i = 0; i < 40; i++)
+    {
+        // 16位差值对微秒计数回绕安全（位周期远小于65ms）
+        uint16_t period = (uint16_t)(_edgeTimes[start + i + 1] - _edgeTimes[start + i]);
+        data[i / 8] <<= 1;
+        if (period > 110)
+        {
+            data[i / 8] |= 1;
+        }
+    }
+
+    if (((data[0] + data[1] + data[2] + data[3]) & 0xFF) != data[4])
+    {
+        _pubsub->publish(F("dht/error"), F("Checksum mismatch"));
+        return;
+    }
+
+    float humidity = (float)((data[0] << 8) | data[1]) / 10.0;
+    uint16_t rawTemperature = ((uint16_t)(data[2] & 0x7F) << 8) | data[3];
+    float temperature = (float)rawTemperature / 10.0;
+    if (data[2] & 0x80)
+    {
+        temperature = -temperature;
+    }
+
+    processReading(temperature, humidity);
+}
+
+#endif // __AVR__
+
+// 读取入口：AVR上触发一次中断捕获（结果在后续loop()解码后发布），
+// 其他平台退回DHT库的阻塞读取
 void DHT22Sensor::readAndPublish()
 {
+#ifdef __AVR__
+    startCapture();
+#else
     float humidity = _dht->readHumidity();
     float temperature = _dht->readTemperature();
 
     if (isnan(humidity) || isnan(temperature))
     {
-        _pubsub->publish("dht/error", "Read failed");
+        _pubsub->publish(F("dht/error"), F("Read failed"));
         return;
     }
 
+    processReading(temperature, humidity);
+#endif
+}
+
+// 读数进入平滑和发布管线（捕获/阻塞两条读取路径共用）
+void DHT22Sensor::processReading(float temperature, float humidity)
+{
+    // EMA更新走Q16.16整数内核，浮点只出现在出入口转换
+    fixed_t temperatureFx = fixedFromFloat(temperature);
+    fixed_t humidityFx = fixedFromFloat(humidity);
+
     if (!_emaInitialized)
     {
-        _emaTemperature = temperature;
-        _emaHumidity = humidity;
+        _emaTemperatureFx = temperatureFx;
+        _emaHumidityFx = humidityFx;
         _emaInitialized = true;
     }
     else
     {
-        _emaTemperature = _emaAlpha * temperature + (1.0 - _emaAlpha) * _emaTemperature;
-        _emaHumidity = _emaAlpha * humidity + (1.0 - _emaAlpha) * _emaHumidity;
+        _emaTemperatureFx = fixedEma(_emaTemperatureFx, temperatureFx, _emaAlphaFx);
+        _emaHumidityFx = fixedEma(_emaHumidityFx, humidityFx, _emaAlphaFx);
     }
 
-    _lastTemperature = _emaTemperature;
-    _lastHumidity = _emaHumidity;
+    _lastTemperature = fixedToFloat(_emaTemperatureFx);
+    _lastHumidity = fixedToFloat(_emaHumidityFx);
+
+    // 变化阈值判断：平滑值相对上次上报变化超过阈值才发布，
+    // 否则只依靠保活周期维持主机端数据新鲜度
+    unsigned long now = millis();
+    bool changed = !_hasPublished ||
+                   fabs(_lastTemperature - _publishedTemperature) >= _publishEpsilon ||
+                   fabs(_lastHumidity - _publishedHumidity) >= _publishEpsilon;
+    bool keepaliveDue = (now - _lastPublishTime) >= _keepaliveInterval;
 
-    publishReading();
+    if (changed || keepaliveDue)
+    {
+        publishReading();
+    }
 }
 
 void DHT22Sensor::publishReading()
@@ -89,15 +297,95 @@ void DHT22Sensor::publishReading()
     char humStr[16];
     char dataMsg[40];
 
-    dtostrf(_lastTemperature, 4, 1, tempStr);
-    dtostrf(_lastHumidity, 4, 1, humStr);
+    // 整数格式化，避免dtostrf拖入浮点printf机制
+    fixedToDecimalString(_emaTemperatureFx, tempStr, 1);
+    fixedToDecimalString(_emaHumidityFx, humStr, 1);
+
+    _pubsub->publish(F("dht/temperature"), tempStr);
 
-    _pubsub->publish("dht/temperature", tempStr);
+    _pubsub->publish(F("dht/humidity"), humStr);
 
-    _pubsub->publish("dht/humidity", humStr);
+    snprintf_P(dataMsg, sizeof(dataMsg), PSTR("%s,%s"), tempStr, humStr);
+    _pubsub->publish(F("dht/data"), dataMsg);
+
+    // 同步写入遥测历史缓冲（x10定点，与发布精度一致）
+    if (_history != nullptr)
+    {
+        int16_t temp_x10 = (int16_t)(((int64_t)_emaTemperatureFx * 10 + (FIXED_ONE / 2)) >> FIXED_SHIFT);
+        uint16_t hum_x10 = (uint16_t)(((int64_t)_emaHumidityFx * 10 + (FIXED_ONE / 2)) >> FIXED_SHIFT);
+        _history->recordDht(temp_x10, hum_x10);
+    }
+
+    // 记录本次上报值，供变化阈值判断使用
+    _publishedTemperature = _lastTemperature;
+    _publishedHumidity = _lastHumidity;
+    _lastPublishTime = millis();
+    _hasPublished = true;
+}
+
+// 发布当前阈值配置
+void DHT22Sensor::publishConfig()
+{
+    char epsStr[8];
+    char configMsg[40];
 
-    snprintf(dataMsg, sizeof(dataMsg), "%s,%s", tempStr, humStr);
-    _pubsub->publish("dht/data", dataMsg);
+    dtostrf(_publishEpsilon, 0, 2, epsStr);
+    snprintf_P(configMsg, sizeof(configMsg), PSTR("epsilon:%s,keepalive:%lu"),
+               epsStr, _keepaliveInterval);
+    _pubsub->publish(F("dht/config/status"), configMsg);
+}
+
+// 配置回调：格式 "epsilon:<value>" 或 "keepalive:<ms>"
+void DHT22Sensor::configCallback(const char *topic, const char *payload)
+{
+    if (_instance == nullptr)
+    {
+        return;
+    }
+
+    if (payload == nullptr || payload[0] == '\0')
+    {
+        _instance->_pubsub->publish(F("dht/error"), F("Invalid config format"));
+        return;
+    }
+
+    const char *separator = strchr(payload, ':');
+    if (separator == nullptr)
+    {
+        _instance->_pubsub->publish(F("dht/error"), F("Invalid config format"));
+        return;
+    }
+
+    int nameLen = separator - payload;
+    const char *valueStr = separator + 1;
+
+    if (nameLen == 7 && strncmp(payload, "epsilon", 7) == 0)
+    {
+        float epsilon = atof(valueStr);
+        if (epsilon < 0.0 || epsilon > 10.0)
+        {
+            _instance->_pubsub->publish(F("dht/error"), F("Epsilon out of range (0-10)"));
+            return;
+        }
+        // epsilon为0时退化为每次读取都发布（旧版行为）
+        _instance->_publishEpsilon = epsilon;
+        _instance->publishConfig();
+    }
+    else if (nameLen == 9 && strncmp(payload, "keepalive", 9) == 0)
+    {
+        long interval = atol(valueStr);
+        if (interval < 200 || interval > 60000)
+        {
+            _instance->_pubsub->publish(F("dht/error"), F("Keepalive out of range (200-60000 ms)"));
+            return;
+        }
+        _instance->_keepaliveInterval = (unsigned long)interval;
+        _instance->publishConfig();
+    }
+    else
+    {
+        _instance->_pubsub->publish(F("dht/error"), F("Unknown config parameter"));
+    }
 }
 
 void DHT22Sensor::queryCallback(const char *topic, const char *payload)
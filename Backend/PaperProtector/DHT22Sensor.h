@@ -4,6 +4,17 @@
 #include <Arduino.h>
 #include <DHT.h>
 #include "SerialPubSub.h"
+#include "FixedPoint.h"
+
+class TelemetryHistory;
+
+// 中断捕获读取状态机状态（仅AVR）
+enum DhtCaptureState
+{
+    DHT_CAPTURE_IDLE,  // 空闲
+    DHT_CAPTURE_START, // 主机起始低脉冲保持中
+    DHT_CAPTURE_EDGES  // 引脚变化中断记录下降沿中
+};
 
 class DHT22Sensor
 {
@@ -14,29 +25,82 @@ public:
 
     void loop();
 
+    // 获取平滑后的缓存读数（供机载控制回路使用）
+    float getTemperature() const;
+    float getHumidity() const;
+    bool hasReading() const;
+
+    // 挂接遥测历史缓冲（可选，发布的读数会同时写入）
+    void setHistory(TelemetryHistory *history);
+
+#ifdef __AVR__
+    // 引脚变化ISR入口（由DHT22Sensor.cpp中的PCINT向量调用）
+    static void handlePinChange();
+#endif
+
 private:
     SerialPubSub *_pubsub;
     DHT *_dht;
     int _dhtPin;
+    TelemetryHistory *_history;
 
     unsigned long _lastReadTime;
     unsigned long _readInterval; // 读取间隔(毫秒)
     unsigned long _startTime;    // 启动时间(用于等待传感器稳定)
 
+#ifdef __AVR__
+    // 中断捕获驱动：DHT库的位敲读取要关中断~5ms，是主循环最大的
+    // 固定延迟尖峰。改为loop()里触发起始脉冲、引脚变化ISR记录每个
+    // 下降沿的micros()时间戳、回到loop()后从捕获缓冲解码40位。
+    // 位周期以下降沿为界：50µs低+26-28µs高为0，50µs低+~70µs高为1
+    // 时间戳存micros()的低16位：整次捕获约5ms，远短于16位
+    // 微秒计数的65ms回绕周期，相邻沿的差值对回绕安全，
+    // 44项从176字节省到88字节SRAM
+    static const uint8_t DHT_EDGE_MAX = 44;
+    static volatile uint16_t _edgeTimes[DHT_EDGE_MAX]; // ISR写入的下降沿时间戳(µs低16位)
+    static volatile uint8_t _edgeCount;
+
+    DhtCaptureState _captureState;  // 捕获状态机状态
+    unsigned long _captureStartUs;  // 进入当前捕获阶段的时刻(µs)
+    volatile uint8_t *_dhtPinReg;   // 数据脚的输入寄存器（ISR快速读电平）
+    uint8_t _dhtBitMask;            // 数据脚的位掩码
+
+    // 起始低脉冲最短保持时间与整次捕获的超时
+    static const unsigned long DHT_START_PULSE_US = 1100;
+    static const unsigned long DHT_CAPTURE_TIMEOUT_US = 6000;
+
+    void startCapture();
+    void runCapture();
+    void decodeCapture();
+#endif
+
     float _lastTemperature;
     float _lastHumidity;
 
-    // EMA滤波器变量
-    float _emaTemperature;
-    float _emaHumidity;
+    // EMA滤波器变量（Q16.16定点内核，见FixedPoint.h）
+    fixed_t _emaTemperatureFx;
+    fixed_t _emaHumidityFx;
     bool _emaInitialized;
-    float _emaAlpha; // 平滑系数 (0-1, 越大响应越快)
+    fixed_t _emaAlphaFx; // 平滑系数 (0-1, 越大响应越快)
+
+    // 变化阈值发布
+    // 平滑值相对上次上报的变化超过阈值才发布，
+    // 另有慢速保活周期保证主机端数据不过期
+    float _publishEpsilon;             // 发布阈值（温度/湿度共用）
+    unsigned long _keepaliveInterval;  // 保活发布周期(毫秒)
+    unsigned long _lastPublishTime;    // 上次发布时刻
+    float _publishedTemperature;       // 上次发布的温度
+    float _publishedHumidity;          // 上次发布的湿度
+    bool _hasPublished;                // 是否已发布过读数
 
     static void queryCallback(const char *topic, const char *payload);
+    static void configCallback(const char *topic, const char *payload);
     static DHT22Sensor *_instance;
 
     void readAndPublish();
+    void processReading(float temperature, float humidity);
     void publishReading();
+    void publishConfig();
 };
 
 #endif
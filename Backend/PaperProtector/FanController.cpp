@@ -3,7 +3,11 @@
 FanController *FanController::_instance = nullptr;
 
 FanController::FanController(SerialPubSub *pubsub, int fanPin)
-    : _pubsub(pubsub), _fanPin(fanPin), _currentSpeed(0)
+    : _pubsub(pubsub), _fanPin(fanPin), _currentSpeed(0),
+      _outputSpeed(0),
+      _rampFullScaleMs(300), // 默认300ms完成0→255全量程变化
+      _lastRampTime(0),
+      _rampAccFx(0)
 {
     _instance = this;
 }
@@ -11,14 +15,119 @@ FanController::FanController(SerialPubSub *pubsub, int fanPin)
 void FanController::begin()
 {
     pinMode(_fanPin, OUTPUT);
-    analogWrite(_fanPin, 0);
+    setupFastPwm();
+    applyRawPwm(0);
 
-    _pubsub->subscribe("fan/speed", speedCallback);
-    _pubsub->subscribe("fan/query", queryCallback);
+    _pubsub->subscribe(F("fan/speed"), speedCallback);
+    _pubsub->subscribe(F("fan/query"), queryCallback);
+    _pubsub->subscribe(F("fan/config"), configCallback);
 }
 
+// 配置高频PWM载波
+// 引脚9/10：Timer1快速PWM模式14，TOP=ICR1，无分频 → 25kHz，风扇无啸叫
+// 引脚3/11：Timer2无分频（保留Arduino核心的相位修正模式）→ ~31kHz
+// 其他引脚（包括Timer0的5/6）保持analogWrite默认载波，
+// 因为重配Timer0会破坏millis()/micros()
+void FanController::setupFastPwm()
+{
+#ifdef __AVR__
+    if (_fanPin == 9 || _fanPin == 10)
+    {
+        TCCR1A |= _BV(WGM11);
+        TCCR1A &= ~_BV(WGM10);
+        TCCR1B = _BV(WGM13) | _BV(WGM12) | _BV(CS10);
+        ICR1 = PWM_TIMER1_TOP;
+        if (_fanPin == 9)
+        {
+            TCCR1A |= _BV(COM1A1);
+        }
+        else
+        {
+            TCCR1A |= _BV(COM1B1);
+        }
+    }
+    else if (_fanPin == 3 || _fanPin == 11)
+    {
+        TCCR2B = (TCCR2B & ~(_BV(CS22) | _BV(CS21))) | _BV(CS20);
+    }
+#endif
+}
+
+// 写PWM占空比（0-255）
+void FanController::applyRawPwm(int value)
+{
+#ifdef __AVR__
+    if (_fanPin == 9 || _fanPin == 10)
+    {
+        // Timer1的TOP已改为640计数，需手动换算占空比
+        uint16_t duty = ((uint32_t)value * PWM_TIMER1_TOP) / 255;
+        if (_fanPin == 9)
+        {
+            OCR1A = duty;
+        }
+        else
+        {
+            OCR1B = duty;
+        }
+        return;
+    }
+#endif
+    analogWrite(_fanPin, value);
+}
+
+// 斜率限制爬升：按配置的全量程时间分步逼近目标值
 void FanController::loop()
 {
+    if (_outputSpeed == _currentSpeed)
+    {
+        return;
+    }
+
+    // 爬升时间为0时立即切换
+    if (_rampFullScaleMs == 0)
+    {
+        _outputSpeed = _currentSpeed;
+        applyRawPwm(_outputSpeed);
+        return;
+    }
+
+    // 每10ms执行一步，步长 = 255 * 10 / 全量程时间（x256定点，
+    // 小数部分跨拍累加——整数步长取下限1会把慢于2550ms的
+    // 爬升配置一律截短成2550ms）
+    unsigned long now = millis();
+    if (now - _lastRampTime < 10)
+    {
+        return;
+    }
+    _lastRampTime = now;
+
+    uint32_t stepFx = (2550UL * 256UL) / _rampFullScaleMs;
+    _rampAccFx += (uint16_t)(stepFx & 0xFF);
+    int step = (int)(stepFx >> 8) + (_rampAccFx >> 8);
+    _rampAccFx &= 0xFF;
+    if (step < 1)
+    {
+        return; // 本拍不足1个PWM计数，留在累加器里下拍补上
+    }
+
+    if (_outputSpeed < _currentSpeed)
+    {
+        _outputSpeed += step;
+        if (_outputSpeed > _currentSpeed)
+        {
+            _outputSpeed = _currentSpeed;
+        }
+    }
+    else
+    {
+        _outputSpeed -= step;
+        if (_outputSpeed < _currentSpeed)
+        {
+            _outputSpeed = _currentSpeed;
+        }
+    }
+
+    applyRawPwm(_outputSpeed);
 }
 
 int FanController::constrainSpeed(int speed)
@@ -36,10 +145,12 @@ void FanController::setSpeed(int speed)
     applySpeed(constrainedSpeed);
 }
 
+// 更新目标转速，实际输出由loop()爬升到位
 void FanController::applySpeed(int speed)
 {
     _currentSpeed = speed;
-    analogWrite(_fanPin, speed);
+    _lastRampTime = millis();
+    _rampAccFx = 0;
     publishStatus();
 }
 
@@ -51,13 +162,18 @@ int FanController::getCurrentSpeed() const
 void FanController::publishStatus()
 {
     char statusMsg[16];
-    sprintf(statusMsg, "%d", _currentSpeed);
-    _pubsub->publish("fan/status", statusMsg);
+    snprintf_P(statusMsg, sizeof(statusMsg), PSTR("%d"), _currentSpeed);
+    _pubsub->publish(F("fan/status"), statusMsg);
 }
 
 void FanController::publishError(const char *error)
 {
-    _pubsub->publish("fan/error", error);
+    _pubsub->publish(F("fan/error"), error);
+}
+
+void FanController::publishError(const __FlashStringHelper* error)
+{
+    _pubsub->publish(F("fan/error"), error);
 }
 
 void FanController::publishCurrentStatus()
@@ -72,7 +188,7 @@ void FanController::speedCallback(const char *topic, const char *payload)
 
     if (payload == nullptr || payload[0] == '\0')
     {
-        _instance->publishError("Empty");
+        _instance->publishError(F("Empty"));
         return;
     }
 
@@ -81,7 +197,7 @@ void FanController::speedCallback(const char *topic, const char *payload)
 
     if (*endPtr != '\0')
     {
-        _instance->publishError("Invalid");
+        _instance->publishError(F("Invalid"));
         return;
     }
 
@@ -95,3 +211,31 @@ void FanController::queryCallback(const char *topic, const char *payload)
 
     _instance->publishCurrentStatus();
 }
+
+// 配置回调：格式 "ramp:<全量程毫秒数>"，0表示立即切换
+void FanController::configCallback(const char *topic, const char *payload)
+{
+    if (_instance == nullptr)
+        return;
+
+    if (payload == nullptr || strncmp(payload, "ramp:", 5) != 0)
+    {
+        _instance->publishError(F("Invalid config"));
+        return;
+    }
+
+    char *endPtr;
+    long rampMs = strtol(payload + 5, &endPtr, 10);
+
+    if (*endPtr != '\0' || rampMs < 0 || rampMs > 10000)
+    {
+        _instance->publishError(F("Ramp out of range (0-10000 ms)"));
+        return;
+    }
+
+    _instance->_rampFullScaleMs = (unsigned long)rampMs;
+
+    char configMsg[24];
+    snprintf_P(configMsg, sizeof(configMsg), PSTR("ramp:%lu"), _instance->_rampFullScaleMs);
+    _instance->_pubsub->publish(F("fan/config/status"), configMsg);
+}
@@ -4,33 +4,47 @@
 #include <Arduino.h>
 #include "SerialPubSub.h"
 
+// Timer1高频PWM的计数上限：16MHz / 640 = 25kHz
+#define PWM_TIMER1_TOP 639
+
 class FanController {
 public:
     FanController(SerialPubSub* pubsub, int fanPin);
-    
+
     void begin();
-    
+
     void loop();
-    
+
     void setSpeed(int speed);
-    
+
     int getCurrentSpeed() const;
-    
+
     void publishCurrentStatus();
-    
+
 private:
     SerialPubSub* _pubsub;
     int _fanPin;
     int _currentSpeed;
-    
+
+    // 斜率限制：setSpeed只更新目标值，loop()按步长逼近，
+    // 避免0→255的跳变冲击5V电源轨
+    int _outputSpeed;               // 当前实际输出的PWM值
+    unsigned long _rampFullScaleMs; // 0→255全量程的爬升时间（0=立即切换）
+    unsigned long _lastRampTime;    // 上次爬升步的时刻
+    uint16_t _rampAccFx;            // 步长小数部分的跨拍累加器（x256定点）
+
     static void speedCallback(const char* topic, const char* payload);
     static void queryCallback(const char* topic, const char* payload);
+    static void configCallback(const char* topic, const char* payload);
     static FanController* _instance;
-    
+
     int constrainSpeed(int speed);
     void applySpeed(int speed);
+    void applyRawPwm(int value);
+    void setupFastPwm();
     void publishStatus();
     void publishError(const char* error);
+    void publishError(const __FlashStringHelper* error);
 };
 
 #endif
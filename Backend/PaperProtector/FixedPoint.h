@@ -0,0 +1,78 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <Arduino.h>
+
+// Q16.16定点数内核
+// AVR无FPU，浮点乘法和dtostrf/"%.1f"格式化都要拖入浮点库；
+// 热路径（EMA滤波、湿度换算、小数格式化）改用这里的整数运算，
+// 公开API仍保留float，仅在出入口做一次转换
+
+typedef int32_t fixed_t;
+
+#define FIXED_SHIFT 16
+#define FIXED_ONE ((fixed_t)1 << FIXED_SHIFT)
+
+// float与Q16.16互转（只应出现在冷路径或出入口）
+static inline fixed_t fixedFromFloat(float value)
+{
+    return (fixed_t)(value * (float)FIXED_ONE);
+}
+
+static inline float fixedToFloat(fixed_t value)
+{
+    return (float)value / (float)FIXED_ONE;
+}
+
+static inline fixed_t fixedFromInt(int16_t value)
+{
+    return (fixed_t)value << FIXED_SHIFT;
+}
+
+// Q16.16乘法（64位中间值避免溢出）
+static inline fixed_t fixedMul(fixed_t a, fixed_t b)
+{
+    return (fixed_t)(((int64_t)a * (int64_t)b) >> FIXED_SHIFT);
+}
+
+// Q16.16除法
+static inline fixed_t fixedDiv(fixed_t a, fixed_t b)
+{
+    return (fixed_t)(((int64_t)a << FIXED_SHIFT) / (int64_t)b);
+}
+
+// EMA滤波一步：prev + alpha * (sample - prev)，全整数运算
+static inline fixed_t fixedEma(fixed_t prev, fixed_t sample, fixed_t alpha)
+{
+    return prev + fixedMul(alpha, sample - prev);
+}
+
+// 纯整数的定点数十进制格式化（decimals限1-2位小数）
+// 替代dtostrf，不触碰浮点printf机制
+static inline void fixedToDecimalString(fixed_t value, char *buffer, uint8_t decimals)
+{
+    char *p = buffer;
+
+    if (value < 0)
+    {
+        *p++ = '-';
+        value = -value;
+    }
+
+    // 小数部分按10^decimals放大后四舍五入
+    long scale = (decimals >= 2) ? 100 : 10;
+    long scaled = (long)(((int64_t)value * scale + (FIXED_ONE / 2)) >> FIXED_SHIFT);
+    long intPart = scaled / scale;
+    long fracPart = scaled % scale;
+
+    ltoa(intPart, p, 10);
+    p += strlen(p);
+    *p++ = '.';
+    if (decimals >= 2 && fracPart < 10)
+    {
+        *p++ = '0';
+    }
+    ltoa(fracPart, p, 10);
+}
+
+#endif
@@ -3,7 +3,11 @@
 Heater *Heater::_instance = nullptr;
 
 Heater::Heater(SerialPubSub *pubsub, int heaterPin)
-    : _pubsub(pubsub), _heaterPin(heaterPin), _currentPower(0)
+    : _pubsub(pubsub), _heaterPin(heaterPin), _currentPower(0),
+      _outputPower(0),
+      _rampFullScaleMs(500), // 加热器热惯性大，默认500ms全量程爬升
+      _lastRampTime(0),
+      _rampAccFx(0)
 {
     _instance = this;
 }
@@ -11,24 +15,128 @@ Heater::Heater(SerialPubSub *pubsub, int heaterPin)
 void Heater::begin()
 {
     pinMode(_heaterPin, OUTPUT);
-    analogWrite(_heaterPin, 0);
+    setupFastPwm();
+    applyRawPwm(0);
 
-    bool sub1 = _pubsub->subscribe("heater/power", powerCallback);
-    bool sub2 = _pubsub->subscribe("heater/query", queryCallback);
+    bool sub1 = _pubsub->subscribe(F("heater/power"), powerCallback);
+    bool sub2 = _pubsub->subscribe(F("heater/query"), queryCallback);
+    _pubsub->subscribe(F("heater/config"), configCallback);
 
     // 调试: 确认订阅
     if (sub1 && sub2)
     {
-        _pubsub->publish("heater/debug", "subscribed_ok");
+        _pubsub->publish(F("heater/debug"), F("subscribed_ok"));
     }
     else
     {
-        _pubsub->publish("heater/debug", "subscribe_failed");
+        _pubsub->publish(F("heater/debug"), F("subscribe_failed"));
     }
 }
 
+// 配置高频PWM载波
+// 引脚9/10走Timer1的25kHz快速PWM，引脚3/11把Timer2调到无分频；
+// 其他引脚（包括Timer0的5/6）保持analogWrite默认载波，
+// 因为重配Timer0会破坏millis()/micros()
+void Heater::setupFastPwm()
+{
+#ifdef __AVR__
+    if (_heaterPin == 9 || _heaterPin == 10)
+    {
+        TCCR1A |= _BV(WGM11);
+        TCCR1A &= ~_BV(WGM10);
+        TCCR1B = _BV(WGM13) | _BV(WGM12) | _BV(CS10);
+        ICR1 = PWM_TIMER1_TOP;
+        if (_heaterPin == 9)
+        {
+            TCCR1A |= _BV(COM1A1);
+        }
+        else
+        {
+            TCCR1A |= _BV(COM1B1);
+        }
+    }
+    else if (_heaterPin == 3 || _heaterPin == 11)
+    {
+        TCCR2B = (TCCR2B & ~(_BV(CS22) | _BV(CS21))) | _BV(CS20);
+    }
+#endif
+}
+
+// 写PWM占空比（0-255）
+void Heater::applyRawPwm(int value)
+{
+#ifdef __AVR__
+    if (_heaterPin == 9 || _heaterPin == 10)
+    {
+        // Timer1的TOP已改为640计数，需手动换算占空比
+        uint16_t duty = ((uint32_t)value * PWM_TIMER1_TOP) / 255;
+        if (_heaterPin == 9)
+        {
+            OCR1A = duty;
+        }
+        else
+        {
+            OCR1B = duty;
+        }
+        return;
+    }
+#endif
+    analogWrite(_heaterPin, value);
+}
+
+// 斜率限制爬升：按配置的全量程时间分步逼近目标值
 void Heater::loop()
 {
+    if (_outputPower == _currentPower)
+    {
+        return;
+    }
+
+    // 爬升时间为0时立即切换
+    if (_rampFullScaleMs == 0)
+    {
+        _outputPower = _currentPower;
+        applyRawPwm(_outputPower);
+        return;
+    }
+
+    // 每10ms执行一步，步长 = 255 * 10 / 全量程时间（x256定点，
+    // 小数部分跨拍累加——整数步长取下限1会把慢于2550ms的
+    // 爬升配置一律截短成2550ms）
+    unsigned long now = millis();
+    if (now - _lastRampTime < 10)
+    {
+        return;
+    }
+    _lastRampTime = now;
+
+    uint32_t stepFx = (2550UL * 256UL) / _rampFullScaleMs;
+    _rampAccFx += (uint16_t)(stepFx & 0xFF);
+    int step = (int)(stepFx >> 8) + (_rampAccFx >> 8);
+    _rampAccFx &= 0xFF;
+    if (step < 1)
+    {
+        return; // 本拍不足1个PWM计数，留在累加器里下拍补上
+    }
+
+    if (_outputPower < _currentPower)
+    {
+        _outputPower += step;
+        if (_outputPower > _currentPower)
+        {
+            _outputPower = _currentPower;
+        }
+    }
+    else
+    {
+        _outputPower -= step;
+        if (_outputPower < _currentPower)
+        {
+            _outputPower = _currentPower;
+        }
+    }
+
+    applyRawPwm(_outputPower);
 }
 
 int Heater::constrainPower(int power)
@@ -46,10 +154,12 @@ void Heater::setPower(int power)
     applyPower(constrainedPower);
 }
 
+// 更新目标功率，实际输出由loop()爬升到位
 void Heater::applyPower(int power)
 {
     _currentPower = power;
-    analogWrite(_heaterPin, power);
+    _lastRampTime = millis();
+    _rampAccFx = 0;
     publishStatus();
 }
 
@@ -61,13 +171,18 @@ int Heater::getCurrentPower() const
 void Heater::publishStatus()
 {
     char statusMsg[16];
-    sprintf(statusMsg, "%d", _currentPower);
-    _pubsub->publish("heater/status", statusMsg);
+    snprintf_P(statusMsg, sizeof(statusMsg), PSTR("%d"), _currentPower);
+    _pubsub->publish(F("heater/status"), statusMsg);
 }
 
 void Heater::publishError(const char *error)
 {
-    _pubsub->publish("heater/error", error);
+    _pubsub->publish(F("heater/error"), error);
+}
+
+void Heater::publishError(const __FlashStringHelper* error)
+{
+    _pubsub->publish(F("heater/error"), error);
 }
 
 void Heater::publishCurrentStatus()
@@ -80,7 +195,7 @@ void Heater::powerCallback(const char *topic, const char *payload)
     // 调试: 确认收到消息
     if (_instance != nullptr)
     {
-        _instance->_pubsub->publish("heater/debug", "callback_called");
+        _instance->_pubsub->publish(F("heater/debug"), F("callback_called"));
     }
 
     if (_instance == nullptr)
@@ -88,7 +203,7 @@ void Heater::powerCallback(const char *topic, const char *payload)
 
     if (payload == nullptr || payload[0] == '\0')
     {
-        _instance->publishError("Empty");
+        _instance->publishError(F("Empty"));
         return;
     }
 
@@ -97,7 +212,7 @@ void Heater::powerCallback(const char *topic, const char *payload)
 
     if (*endPtr != '\0')
     {
-        _instance->publishError("Invalid");
+        _instance->publishError(F("Invalid"));
         return;
     }
 
@@ -111,3 +226,31 @@ void Heater::queryCallback(const char *topic, const char *payload)
 
     _instance->publishCurrentStatus();
 }
+
+// 配置回调：格式 "ramp:<全量程毫秒数>"，0表示立即切换
+void Heater::configCallback(const char *topic, const char *payload)
+{
+    if (_instance == nullptr)
+        return;
+
+    if (payload == nullptr || strncmp(payload, "ramp:", 5) != 0)
+    {
+        _instance->publishError(F("Invalid config"));
+        return;
+    }
+
+    char *endPtr;
+    long rampMs = strtol(payload + 5, &endPtr, 10);
+
+    if (*endPtr != '\0' || rampMs < 0 || rampMs > 10000)
+    {
+        _instance->publishError(F("Ramp out of range (0-10000 ms)"));
+        return;
+    }
+
+    _instance->_rampFullScaleMs = (unsigned long)rampMs;
+
+    char configMsg[24];
+    snprintf_P(configMsg, sizeof(configMsg), PSTR("ramp:%lu"), _instance->_rampFullScaleMs);
+    _instance->_pubsub->publish(F("heater/config/status"), configMsg);
+}
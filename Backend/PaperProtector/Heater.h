@@ -4,33 +4,49 @@
 #include <Arduino.h>
 #include "SerialPubSub.h"
 
+// Timer1高频PWM的计数上限：16MHz / 640 = 25kHz
+#ifndef PWM_TIMER1_TOP
+#define PWM_TIMER1_TOP 639
+#endif
+
 class Heater {
 public:
     Heater(SerialPubSub* pubsub, int heaterPin);
-    
+
     void begin();
-    
+
     void loop();
-    
+
     void setPower(int power);
-    
+
     int getCurrentPower() const;
-    
+
     void publishCurrentStatus();
-    
+
 private:
     SerialPubSub* _pubsub;
     int _heaterPin;
     int _currentPower;
-    
+
+    // 斜率限制：setPower只更新目标值，loop()按步长逼近，
+    // 避免大功率跳变的电流冲击拉低5V电源轨
+    int _outputPower;               // 当前实际输出的PWM值
+    unsigned long _rampFullScaleMs; // 0→255全量程的爬升时间（0=立即切换）
+    unsigned long _lastRampTime;    // 上次爬升步的时刻
+    uint16_t _rampAccFx;            // 步长小数部分的跨拍累加器（x256定点）
+
     static void powerCallback(const char* topic, const char* payload);
     static void queryCallback(const char* topic, const char* payload);
+    static void configCallback(const char* topic, const char* payload);
     static Heater* _instance;
-    
+
     int constrainPower(int power);
     void applyPower(int power);
+    void applyRawPwm(int value);
+    void setupFastPwm();
     void publishStatus();
     void publishError(const char* error);
+    void publishError(const __FlashStringHelper* error);
 };
 
 #endif
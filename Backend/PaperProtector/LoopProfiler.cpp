@@ -0,0 +1,135 @@
+#include "LoopProfiler.h"
+
+LoopProfiler::LoopProfiler(SerialPubSub *pubsub)
+    : _pubsub(pubsub),
+      _slotCount(0),
+      _frameStartUs(0),
+      _lastMarkUs(0),
+      _spikeCount(0),
+      _worstFrameUs(0),
+      _lastPublishTime(0)
+{
+    for (int i = 0; i < PROFILER_MAX_SLOTS; i++)
+    {
+        _slots[i].name = nullptr;
+        _slots[i].sumUs = 0;
+        _slots[i].count = 0;
+        _slots[i].maxUs = 0;
+        _slots[i].p99Fx = 0;
+    }
+}
+
+int LoopProfiler::addModule(const char *name)
+{
+    if (_slotCount >= PROFILER_MAX_SLOTS)
+    {
+        return -1;
+    }
+    _slots[_slotCount].name = name;
+    return _slotCount++;
+}
+
+void LoopProfiler::startFrame()
+{
+    _frameStartUs = micros();
+    _lastMarkUs = _frameStartUs;
+}
+
+// 记录自上一次标记以来的耗时
+// p99用frugal流式估计：样本高于估计值时加0.5us，低于时减1/256us，
+// 平衡点约在第99百分位附近，无需保存样本历史
+void LoopProfiler::sample(int slot)
+{
+    unsigned long now = micros();
+
+    if (slot < 0 || slot >= _slotCount)
+    {
+        _lastMarkUs = now;
+        return;
+    }
+
+    unsigned long elapsed = now - _lastMarkUs;
+    _lastMarkUs = now;
+
+    SlotStats &s = _slots[slot];
+    s.sumUs += elapsed;
+    s.count++;
+    if (elapsed > s.maxUs)
+    {
+        s.maxUs = (elapsed > 65535UL) ? 65535 : (uint16_t)elapsed;
+    }
+
+    uint32_t elapsedFx = (uint32_t)elapsed << 8;
+    if (elapsedFx > s.p99Fx)
+    {
+        s.p99Fx += 128; // +0.5us
+    }
+    else if (s.p99Fx > 0)
+    {
+        s.p99Fx -= 1; // -1/256us
+    }
+}
+
+void LoopProfiler::endFrame()
+{
+    unsigned long frameUs = micros() - _frameStartUs;
+
+    if (frameUs > SPIKE_THRESHOLD_US)
+    {
+        _spikeCount++;
+    }
+    if (frameUs > _worstFrameUs)
+    {
+        _worstFrameUs = (frameUs > 65535UL) ? 65535 : (uint16_t)frameUs;
+    }
+
+    unsigned long now = millis();
+    if (now - _lastPublishTime >= PUBLISH_INTERVAL_MS)
+    {
+        _lastPublishTime = now;
+        publishStats();
+        resetWindow();
+    }
+}
+
+// 发布紧凑摘要：每个槽位为 名字:均值,最大,p99（单位微秒）
+// 末尾附整帧尖峰计数和窗口内最长帧
+void LoopProfiler::publishStats()
+{
+    char payload[MAX_MESSAGE_LENGTH];
+    int pos = 0;
+
+    for (int i = 0; i < _slotCount; i++)
+    {
+        SlotStats &s = _slots[i];
+        unsigned long mean = (s.count > 0) ? (s.sumUs / s.count) : 0;
+        int written = snprintf_P(payload + pos, sizeof(payload) - pos,
+                                 PSTR("%s%s:%lu,%u,%lu"),
+                                 (pos > 0) ? ";" : "",
+                                 s.name, mean, s.maxUs,
+                                 (unsigned long)(s.p99Fx >> 8));
+        if (written < 0 || pos + written >= (int)sizeof(payload))
+        {
+            break;
+        }
+        pos += written;
+    }
+
+    snprintf_P(payload + pos, sizeof(payload) - pos,
+               PSTR(";spk:%u,worst:%u"), _spikeCount, _worstFrameUs);
+
+    _pubsub->publish(F("system/loopstats"), payload);
+}
+
+// 清零窗口统计（p99估计跨窗口保留，收敛需要样本量）
+void LoopProfiler::resetWindow()
+{
+    for (int i = 0; i < _slotCount; i++)
+    {
+        _slots[i].sumUs = 0;
+        _slots[i].count = 0;
+        _slots[i].maxUs = 0;
+    }
+    _spikeCount = 0;
+    _worstFrameUs = 0;
+}
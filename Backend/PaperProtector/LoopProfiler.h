@@ -0,0 +1,62 @@
+#ifndef LOOP_PROFILER_H
+#define LOOP_PROFILER_H
+
+#include <Arduino.h>
+#include "SerialPubSub.h"
+
+// 主循环各模块的耗时剖析槽位数（当前注册7个，留1个给AS7341重新启用）
+#define PROFILER_MAX_SLOTS 8
+
+// 轻量主循环剖析器
+// 在PaperProtector.ino的loop()中为每个模块记录一次micros()间隔，
+// 按槽位累计窗口内的均值/最大值和持续的p99估计，
+// 每隔几秒在system/loopstats上发布一行紧凑摘要。
+// 单次record只有几次加法和比较，空闲时开销可忽略
+class LoopProfiler
+{
+public:
+    LoopProfiler(SerialPubSub *pubsub);
+
+    // 注册一个模块槽位（name建议为2-3字符缩写），返回槽位号
+    int addModule(const char *name);
+
+    // 标记帧起点（loop()开头调用一次）
+    void startFrame();
+
+    // 记录自上一次标记以来的耗时到指定槽位
+    void sample(int slot);
+
+    // 帧结束：检测整帧尖峰并按周期发布摘要
+    void endFrame();
+
+private:
+    struct SlotStats
+    {
+        const char *name;    // 模块缩写（指向静态字符串，不复制）
+        unsigned long sumUs; // 窗口内耗时累计
+        unsigned long count; // 窗口内采样次数
+        uint16_t maxUs;      // 窗口内单次最大耗时
+        uint32_t p99Fx;      // p99估计（Q8定点，微秒x256）
+    };
+
+    SerialPubSub *_pubsub;
+    SlotStats _slots[PROFILER_MAX_SLOTS];
+    uint8_t _slotCount;
+
+    unsigned long _frameStartUs; // 当前帧起点
+    unsigned long _lastMarkUs;   // 上一次sample标记时刻
+
+    unsigned int _spikeCount;          // 窗口内整帧超阈值次数
+    uint16_t _worstFrameUs;            // 窗口内最长整帧耗时
+    unsigned long _lastPublishTime;    // 上次发布摘要时刻
+
+    // 整帧耗时超过此值计为一次尖峰
+    static const unsigned long SPIKE_THRESHOLD_US = 5000;
+    // 摘要发布周期
+    static const unsigned long PUBLISH_INTERVAL_MS = 5000;
+
+    void publishStats();
+    void resetWindow();
+};
+
+#endif
@@ -1,16 +1,31 @@
 #include "MoistureSensor.h"
+#include "TelemetryHistory.h"
+#include <EEPROM.h>
 
 // 静态成员初始化
 MoistureSensor *MoistureSensor::_instance = nullptr;
 
 MoistureSensor::MoistureSensor(SerialPubSub *pubsub, int irledPin)
     : _pubsub(pubsub),
+      _history(nullptr),
       _irledPin(irledPin),
       _irledState(false),
       _lastMeasurementTime(0),
+      _measureState(MEASURE_IDLE),
+      _stateEnteredTime(0),
+      _measureRetry(0),
+      _measureTuneRestart(0),
+      _pendingAmbient(0.0),
       _gain(AS7341_GAIN_128X),
-      _integrationTime(100)
+      _integrationTime(100),
+      _lastAmbientBucket(-1),
+      _autoTune(true)
 {
+    // 自动调谐缓存初始为空，首次测量后逐档填充
+    for (int i = 0; i < TUNE_BUCKETS; i++)
+    {
+        _tunedCache[i].valid = false;
+    }
 
     // 初始化校准数据
     _calibration.dryBaseline = 0.0;
@@ -18,6 +33,9 @@ MoistureSensor::MoistureSensor(SerialPubSub *pubsub, int irledPin)
     _calibration.timestamp = 0;
     _calibration.isValid = false;
 
+    _calibSlot = -1;
+    _calibSequence = 0;
+
     // 设置静态实例指针
     _instance = this;
 }
@@ -29,17 +47,17 @@ bool MoistureSensor::begin()
     setIRLED(false); // 初始状态关闭
 
     // 订阅 IR LED 控制主题(独立于传感器,总是可用)
-    _pubsub->subscribe("irled/control", irledControlCallback);
-    _pubsub->subscribe("irled/get", irledGetCallback);
+    _pubsub->subscribe(F("irled/control"), irledControlCallback);
+    _pubsub->subscribe(F("irled/get"), irledGetCallback);
 
     // 发布初始 LED 状态
-    _pubsub->publish("irled/status", "off");
+    _pubsub->publish(F("irled/status"), F("off"));
 
     // 初始化AS7341传感器
     if (!_sensor.begin())
     {
-        publishError("AS7341 sensor not found");
-        _pubsub->publish("moisture/status", "sensor_error");
+        publishError(F("AS7341 sensor not found"));
+        _pubsub->publish(F("moisture/status"), F("sensor_error"));
         // 即使传感器失败,IR LED 控制仍然可用
         return false;
     }
@@ -48,139 +66,335 @@ bool MoistureSensor::begin()
     _sensor.setGain(_gain);
     _sensor.setATIME(_integrationTime);
 
+    // 从EEPROM恢复上次的干湿基准，上电即达到完整测量精度
+    if (loadCalibration())
+    {
+        publishCalibration("restored", _calibration.dryBaseline, true);
+    }
+
     // 订阅湿度传感器相关主题
-    _pubsub->subscribe("moisture/measure", measureCallback);
-    _pubsub->subscribe("moisture/calibrate", calibrateCallback);
-    _pubsub->subscribe("moisture/config", configCallback);
+    _pubsub->subscribe(F("moisture/measure"), measureCallback);
+    _pubsub->subscribe(F("moisture/calibrate"), calibrateCallback);
+    _pubsub->subscribe(F("moisture/config"), configCallback);
 
     // 发布初始化成功消息
-    _pubsub->publish("moisture/status", "ready");
+    _pubsub->publish(F("moisture/status"), F("ready"));
 
     return true;
 }
 
+// 主循环 - 驱动异步测量状态机
+// 一次完整测量流程：LED关→稳定→环境光积分→LED开→稳定→反射光积分→计算发布
+// 每个阶段只轮询不等待，湿度采样不再阻塞步进运动和串口处理
 void MoistureSensor::loop()
 {
-    // 处理SerialPubSub消息
-    // SerialPubSub的loop()方法在主程序中调用，这里不需要重复调用
-    // 此方法保留用于未来的异步处理逻辑
-
-    // 当前实现：所有消息处理通过回调函数完成
-    // 测量频率限制在measure()方法中实现
-    // 传感器饱和处理在measure()方法中实现
-}
+    switch (_measureState)
+    {
+    case MEASURE_IDLE:
+        break;
 
-MoistureSensor::MeasurementResult MoistureSensor::measure()
-{
-    MeasurementResult result = {false, 0.0, false};
+    case MEASURE_AMBIENT_SETTLE:
+        // LED已关闭，等待稳定后启动环境光积分
+        if (millis() - _stateEnteredTime >= LED_SETTLE_MS)
+        {
+            _sensor.startReading();
+            enterMeasureState(MEASURE_AMBIENT_READING);
+        }
+        break;
 
-    // 检查测量频率限制（最小间隔500ms）
-    unsigned long currentTime = millis();
-    if (currentTime - _lastMeasurementTime < MIN_MEASUREMENT_INTERVAL)
-    {
-        publishError("Measurement too frequent");
-        return result;
-    }
-    _lastMeasurementTime = currentTime;
+    case MEASURE_AMBIENT_READING:
+        if (_sensor.checkReadingProgress())
+        {
+            if (!_sensor.getAllChannels(_measureReadings))
+            {
+                retryMeasurement();
+                break;
+            }
 
-    // 重试机制（最多3次）
-    for (int retry = 0; retry < MAX_RETRIES; retry++)
-    {
-        uint16_t readings[12];
+            // 检查环境光是否饱和
+            if (handleSaturation(_measureReadings))
+            {
+                // 增益已调整，重新开始本次测量（不占通信重试配额）
+                restartMeasurement();
+                break;
+            }
 
-        // 步骤1: 测量环境光强度（IRLED关闭）
-        setIRLED(false);
+            _pendingAmbient = _measureReadings[AS7341_CHANNEL_NIR];
 
-        if (!_sensor.readAllChannels(readings))
-        {
-            // 读取失败，重试
-            if (retry < MAX_RETRIES - 1)
+            // 归类本次光照档位；若与测量起点的档位不符且该档已有
+            // 收敛设定，则换用缓存设定重新开始（环境光与反射光两个
+            // 阶段必须在同一增益/积分时间下读取才能做背景扣除）
+            int bucket = ambientBucket(_measureReadings[AS7341_CHANNEL_NIR]);
+            if (_autoTune && bucket != _lastAmbientBucket &&
+                _tunedCache[bucket].valid &&
+                (_tunedCache[bucket].gain != _gain ||
+                 _tunedCache[bucket].atime != _integrationTime))
             {
-                delay(RETRY_DELAY_MS);
+                _lastAmbientBucket = bucket;
+                setGain(_tunedCache[bucket].gain);
+                setIntegrationTime(_tunedCache[bucket].atime);
+                restartMeasurement();
+                break;
             }
-            continue;
+            _lastAmbientBucket = bucket;
+
+            // 保存全通道环境光读数，供完成后的光谱分析扣除背景
+            memcpy(_ambientReadings, _measureReadings, sizeof(_ambientReadings));
+
+            // 打开IRLED，进入反射光阶段
+            setIRLED(true);
+            enterMeasureState(MEASURE_LED_SETTLE);
         }
+        break;
 
-        // 检查环境光是否饱和
-        if (handleSaturation(readings))
+    case MEASURE_LED_SETTLE:
+        // LED已打开，等待稳定后启动反射光积分
+        if (millis() - _stateEnteredTime >= LED_SETTLE_MS)
         {
-            // 增益已调整，重新测量
-            if (retry < MAX_RETRIES - 1)
-            {
-                delay(RETRY_DELAY_MS);
-            }
-            continue;
+            _sensor.startReading();
+            enterMeasureState(MEASURE_LED_READING);
         }
+        break;
 
-        float ambientIntensity = readings[AS7341_CHANNEL_NIR];
+    case MEASURE_LED_READING:
+        if (_sensor.checkReadingProgress())
+        {
+            // 积分结束立即关闭LED
+            setIRLED(false);
 
-        // 步骤2: 打开IRLED并测量总光强度
-        setIRLED(true);
+            if (!_sensor.getAllChannels(_measureReadings))
+            {
+                retryMeasurement();
+                break;
+            }
 
-        if (!_sensor.readAllChannels(readings))
-        {
-            setIRLED(false); // 确保关闭LED
-            // 读取失败，重试
-            if (retry < MAX_RETRIES - 1)
+            // 检查反射光是否饱和
+            if (handleSaturation(_measureReadings))
             {
-                delay(RETRY_DELAY_MS);
+                restartMeasurement();
+                break;
             }
-            continue;
-        }
 
-        // 检查反射光是否饱和
-        if (handleSaturation(readings))
-        {
-            setIRLED(false); // 确保关闭LED
-            // 增益已调整，重新测量
-            if (retry < MAX_RETRIES - 1)
+            // 本次读数有效：用峰值余量为下次测量收敛增益/积分时间
+            autotune(_measureReadings);
+
+            float totalIntensity = _measureReadings[AS7341_CHANNEL_NIR];
+
+            // 计算净反射光强度
+            float reflectedIntensity = totalIntensity - _pendingAmbient;
+            if (reflectedIntensity < 0)
             {
-                delay(RETRY_DELAY_MS);
+                reflectedIntensity = 0;
             }
-            continue;
+
+            finishMeasurement(reflectedIntensity, _pendingAmbient);
         }
+        break;
+    }
+}
 
-        float totalIntensity = readings[AS7341_CHANNEL_NIR];
+// 启动一次异步测量，成功返回true
+bool MoistureSensor::startMeasurement()
+{
+    // 已有测量在进行
+    if (_measureState != MEASURE_IDLE)
+    {
+        publishError(F("Measurement in progress"));
+        return false;
+    }
 
-        // 步骤3: 测量完成后关闭IRLED
-        setIRLED(false);
+    // 检查测量频率限制（最小间隔500ms）
+    unsigned long currentTime = millis();
+    if (currentTime - _lastMeasurementTime < MIN_MEASUREMENT_INTERVAL)
+    {
+        publishError(F("Measurement too frequent"));
+        return false;
+    }
+    _lastMeasurementTime = currentTime;
 
-        // 步骤4: 计算净反射光强度
-        float reflectedIntensity = totalIntensity - ambientIntensity;
-        if (reflectedIntensity < 0)
-        {
-            reflectedIntensity = 0;
-        }
+    _measureRetry = 0;
+    _measureTuneRestart = 0;
 
-        // 测量成功，检测纸张存在性
-        result.paperPresent = detectPaper(reflectedIntensity, ambientIntensity);
-        result.isValid = true;
+    // 用上次同光照档位收敛的设定做起点，
+    // 典型情况下一趟积分就能得到有效读数
+    seedTunedSettings();
 
-        // 如果有纸张，调用calculateMoisture()计算湿度
-        if (result.paperPresent)
-        {
-            result.moisturePercent = calculateMoisture(reflectedIntensity);
-        }
-        else
+    setIRLED(false);
+    enterMeasureState(MEASURE_AMBIENT_SETTLE);
+    return true;
+}
+
+bool MoistureSensor::isMeasuring() const
+{
+    return _measureState != MEASURE_IDLE;
+}
+
+// 切换状态机状态并记录进入时刻
+void MoistureSensor::enterMeasureState(MoistureMeasureState state)
+{
+    _measureState = state;
+    _stateEnteredTime = millis();
+}
+
+// 测量失败或增益调整后重新开始，超过重试上限则报错
+void MoistureSensor::retryMeasurement()
+{
+    setIRLED(false);
+
+    _measureRetry++;
+    if (_measureRetry >= MAX_RETRIES)
+    {
+        failMeasurement(F("Sensor communication failed after retries"));
+        return;
+    }
+
+    // 从环境光阶段重新开始（稳定等待兼作重试间隔）
+    enterMeasureState(MEASURE_AMBIENT_SETTLE);
+}
+
+// 增益/积分时间切换后重新开始本次测量
+// 走独立的重启配额：设定切换是调谐的正常路径，不占用通信
+// 重试配额；超限说明设定在来回震荡，报专门的错误便于区分
+void MoistureSensor::restartMeasurement()
+{
+    setIRLED(false);
+
+    _measureTuneRestart++;
+    if (_measureTuneRestart >= MAX_TUNE_RESTARTS)
+    {
+        failMeasurement(F("Sensor settings did not settle"));
+        return;
+    }
+
+    enterMeasureState(MEASURE_AMBIENT_SETTLE);
+}
+
+// 测量失败收尾
+void MoistureSensor::failMeasurement(const char *error)
+{
+    setIRLED(false);
+    _measureState = MEASURE_IDLE;
+    publishError(error);
+}
+
+void MoistureSensor::failMeasurement(const __FlashStringHelper *error)
+{
+    setIRLED(false);
+    _measureState = MEASURE_IDLE;
+    publishError(error);
+}
+
+// 测量成功收尾：计算结果并发布
+void MoistureSensor::finishMeasurement(float reflectedIntensity, float ambientIntensity)
+{
+    _measureState = MEASURE_IDLE;
+
+    MeasurementResult result;
+    result.paperPresent = detectPaper(reflectedIntensity, ambientIntensity);
+    result.isValid = true;
+
+    if (result.paperPresent)
+    {
+        result.moisturePercent = calculateMoisture(reflectedIntensity);
+    }
+    else
+    {
+        result.moisturePercent = 0.0;
+    }
+
+    publishMeasurement(result);
+
+    // 同一次积分的12通道读数顺带做全谱分析，不消耗额外的传感器读取
+    if (result.paperPresent)
+    {
+        analyzeSpectrum(_measureReadings, _ambientReadings);
+    }
+}
+
+// 全谱批处理：一趟遍历已付过积分时间的12通道读数，
+// 计算各波段归一化反射率（千分比）和纸张类型判别
+// F1-F8为415-680nm可见光波段，NIR约910nm
+void MoistureSensor::analyzeSpectrum(const uint16_t *ledReadings, const uint16_t *ambientReadings)
+{
+    static const uint8_t BAND_CHANNELS[8] = {
+        AS7341_CHANNEL_415nm_F1, AS7341_CHANNEL_445nm_F2,
+        AS7341_CHANNEL_480nm_F3, AS7341_CHANNEL_515nm_F4,
+        AS7341_CHANNEL_555nm_F5, AS7341_CHANNEL_590nm_F6,
+        AS7341_CHANNEL_630nm_F7, AS7341_CHANNEL_680nm_F8};
+
+    long net[8];
+    long visibleTotal = 0;
+
+    // 单趟：扣除环境光并累加可见光总量
+    for (int i = 0; i < 8; i++)
+    {
+        uint8_t ch = BAND_CHANNELS[i];
+        net[i] = (long)ledReadings[ch] - (long)ambientReadings[ch];
+        if (net[i] < 0)
         {
-            result.moisturePercent = 0.0;
+            net[i] = 0;
         }
+        visibleTotal += net[i];
+    }
 
-        // 返回MeasurementResult结构体
-        return result;
+    long nirNet = (long)ledReadings[AS7341_CHANNEL_NIR] -
+                  (long)ambientReadings[AS7341_CHANNEL_NIR];
+    if (nirNet < 0)
+    {
+        nirNet = 0;
+    }
+
+    // 可见光信号太弱时谱形无意义，不发布
+    if (visibleTotal < 100)
+    {
+        return;
     }
 
-    // 所有重试失败
-    publishError("Sensor communication failed after retries");
-    return result;
+    // 各波段占可见光总量的千分比
+    int permille[8];
+    for (int i = 0; i < 8; i++)
+    {
+        permille[i] = (int)((net[i] * 1000L) / visibleTotal);
+    }
+
+    // NIR相对可见光的千分比：水对NIR吸收强于可见光，
+    // 该比值随纸张湿度上升而下降，可作多波段湿度佐证
+    long nirRatio = (nirNet * 1000L) / visibleTotal;
+
+    // 纸张类型判别：蓝端(F1+F2)与红端(F7+F8)的谱形倾斜
+    // 增白剂使白纸偏蓝，牛皮纸/再生纸明显偏红，接近平坦为普通白纸
+    long blueEnd = net[0] + net[1];
+    long redEnd = net[6] + net[7];
+    const char *paperType;
+    if (redEnd * 10 >= blueEnd * 14)
+    {
+        paperType = "kraft";
+    }
+    else if (blueEnd * 10 >= redEnd * 14)
+    {
+        paperType = "bright_white";
+    }
+    else
+    {
+        paperType = "plain_white";
+    }
+
+    char payload[128];
+    snprintf_P(payload, sizeof(payload),
+               PSTR("f1:%d,f2:%d,f3:%d,f4:%d,f5:%d,f6:%d,f7:%d,f8:%d,nir:%ld,type:%s"),
+               permille[0], permille[1], permille[2], permille[3],
+               permille[4], permille[5], permille[6], permille[7],
+               nirRatio, paperType);
+    _pubsub->publish(F("moisture/spectrum"), payload);
 }
 
 float MoistureSensor::readAmbientIntensity()
 {
     uint16_t readings[12];
 
-    // 确保IRLED关闭
+    // 确保IRLED关闭并等待稳定
     setIRLED(false);
+    delay(LED_SETTLE_MS);
 
     if (!_sensor.readAllChannels(readings))
     {
@@ -197,6 +411,7 @@ float MoistureSensor::readNIRIntensity()
 
     // 步骤1: 测量环境光强度（IRLED关闭）
     setIRLED(false);
+    delay(LED_SETTLE_MS);
 
     if (!_sensor.readAllChannels(readings))
     {
@@ -208,6 +423,7 @@ float MoistureSensor::readNIRIntensity()
 
     // 步骤2: 打开IRLED并测量总光强度
     setIRLED(true);
+    delay(LED_SETTLE_MS);
 
     if (!_sensor.readAllChannels(readings))
     {
@@ -244,52 +460,47 @@ bool MoistureSensor::detectPaper(float intensity, float ambient)
 
 float MoistureSensor::calculateMoisture(float intensity)
 {
-    float moisture = 0.0;
+    // 整数内核：强度为ADC计数，按0.1%精度做线性插值，
+    // 浮点只出现在出入口转换
+    // moisture% = 100 * (I_dry - I_reflected) / (I_dry - I_wet)
+    long intensityCounts = (long)intensity;
+    long dryCounts;
+    long wetCounts;
 
     // 检查校准数据是否有效
     if (_calibration.isValid && _calibration.dryBaseline > _calibration.wetBaseline)
     {
-        // 使用校准的线性插值模型
-        // moisture% = 100 * (I_dry - I_reflected) / (I_dry - I_wet)
-        float numerator = _calibration.dryBaseline - intensity;
-        float denominator = _calibration.dryBaseline - _calibration.wetBaseline;
-
-        // 避免除以零
-        if (denominator > 0.1)
-        {
-            moisture = 100.0 * numerator / denominator;
-        }
-        else
-        {
-            // 校准数据无效（干湿基准太接近）
-            moisture = 0.0;
-        }
+        dryCounts = (long)_calibration.dryBaseline;
+        wetCounts = (long)_calibration.wetBaseline;
     }
     else
     {
         // 未校准情况：使用默认映射
         // 假设典型的NIR反射范围：干燥纸张 ~1000-2000，湿润纸张 ~200-500
-        // 使用简单的线性映射作为默认值
-        const float DEFAULT_DRY_BASELINE = 1500.0;
-        const float DEFAULT_WET_BASELINE = 300.0;
-
-        float numerator = DEFAULT_DRY_BASELINE - intensity;
-        float denominator = DEFAULT_DRY_BASELINE - DEFAULT_WET_BASELINE;
+        dryCounts = 1500;
+        wetCounts = 300;
+    }
 
-        moisture = 100.0 * numerator / denominator;
+    // 避免除以零（干湿基准太接近视为校准无效）
+    long denominator = dryCounts - wetCounts;
+    if (denominator < 1)
+    {
+        return 0.0;
     }
 
+    long moisture_x10 = ((dryCounts - intensityCounts) * 1000L) / denominator;
+
     // 确保返回值在[0, 100]范围内
-    if (moisture < 0.0)
+    if (moisture_x10 < 0)
     {
-        moisture = 0.0;
+        moisture_x10 = 0;
     }
-    else if (moisture > 100.0)
+    else if (moisture_x10 > 1000)
     {
-        moisture = 100.0;
+        moisture_x10 = 1000;
     }
 
-    return moisture;
+    return (float)moisture_x10 / 10.0;
 }
 
 bool MoistureSensor::calibrateDry()
@@ -300,7 +511,7 @@ bool MoistureSensor::calibrateDry()
     // 检查测量是否成功
     if (intensity < 0)
     {
-        publishError("Failed to read NIR intensity during dry calibration");
+        publishError(F("Failed to read NIR intensity during dry calibration"));
         return false;
     }
 
@@ -314,6 +525,9 @@ bool MoistureSensor::calibrateDry()
         _calibration.isValid = true;
     }
 
+    // 持久化到EEPROM，断电后不丢失
+    saveCalibration();
+
     // 通过SerialPubSub发布校准结果消息
     publishCalibration("dry", _calibration.dryBaseline, true);
 
@@ -328,7 +542,7 @@ bool MoistureSensor::calibrateWet()
     // 检查测量是否成功
     if (intensity < 0)
     {
-        publishError("Failed to read NIR intensity during wet calibration");
+        publishError(F("Failed to read NIR intensity during wet calibration"));
         return false;
     }
 
@@ -342,12 +556,86 @@ bool MoistureSensor::calibrateWet()
         _calibration.isValid = true;
     }
 
+    // 持久化到EEPROM，断电后不丢失
+    saveCalibration();
+
     // 通过SerialPubSub发布校准结果消息
     publishCalibration("wet", _calibration.wetBaseline, true);
 
     return true;
 }
 
+// 计算校准记录的异或校验（不含checksum字段本身）
+uint8_t MoistureSensor::recordChecksum(const CalibrationRecord &record)
+{
+    const uint8_t *bytes = (const uint8_t *)&record;
+    uint8_t checksum = 0x5A; // 非零种子，避免全零记录校验通过
+    for (size_t i = 0; i < sizeof(CalibrationRecord) - 1; i++)
+    {
+        checksum ^= bytes[i];
+    }
+    return checksum;
+}
+
+// 从EEPROM加载最新的有效校准记录
+// 扫描全部槽位，取校验通过且序号最大的一条
+bool MoistureSensor::loadCalibration()
+{
+    CalibrationRecord record;
+    int bestSlot = -1;
+    uint16_t bestSequence = 0;
+    CalibrationRecord bestRecord;
+
+    for (int slot = 0; slot < EEPROM_CALIB_SLOTS; slot++)
+    {
+        EEPROM.get(EEPROM_CALIB_BASE + slot * (int)sizeof(CalibrationRecord), record);
+
+        if (record.magic != CALIB_MAGIC)
+        {
+            continue;
+        }
+        if (record.checksum != recordChecksum(record))
+        {
+            continue;
+        }
+        if (bestSlot < 0 || (int16_t)(record.sequence - bestSequence) > 0)
+        {
+            bestSlot = slot;
+            bestSequence = record.sequence;
+            bestRecord = record;
+        }
+    }
+
+    if (bestSlot < 0)
+    {
+        return false;
+    }
+
+    _calibSlot = bestSlot;
+    _calibSequence = bestSequence;
+    _calibration.dryBaseline = bestRecord.dryBaseline;
+    _calibration.wetBaseline = bestRecord.wetBaseline;
+    _calibration.isValid = (bestRecord.flags & 0x01) != 0;
+    _calibration.timestamp = 0; // millis时间戳跨上电无意义
+
+    return _calibration.isValid;
+}
+
+// 将当前校准数据写入下一个槽位（轮转磨损均衡）
+void MoistureSensor::saveCalibration()
+{
+    CalibrationRecord record;
+    record.magic = CALIB_MAGIC;
+    record.sequence = ++_calibSequence;
+    record.dryBaseline = _calibration.dryBaseline;
+    record.wetBaseline = _calibration.wetBaseline;
+    record.flags = _calibration.isValid ? 0x01 : 0x00;
+    record.checksum = recordChecksum(record);
+
+    _calibSlot = (_calibSlot + 1) % EEPROM_CALIB_SLOTS;
+    EEPROM.put(EEPROM_CALIB_BASE + _calibSlot * (int)sizeof(CalibrationRecord), record);
+}
+
 void MoistureSensor::setGain(as7341_gain_t gain)
 {
     _gain = gain;
@@ -360,6 +648,133 @@ void MoistureSensor::setIntegrationTime(uint16_t time)
     _sensor.setATIME(time);
 }
 
+void MoistureSensor::setAutoTune(bool enabled)
+{
+    _autoTune = enabled;
+}
+
+// 将环境光NIR强度归入4个光照档位（暗/弱/亮/强光）
+// 原始计数随增益和积分时间线性缩放，先归一到默认设定
+// （128x增益、ATIME 100）下的等效计数再分档——否则同一光照在
+// 不同设定下落入不同档位，缓存设定会在档位间来回切换。
+// 档位边界按4倍递进，对应增益级差的量级
+int MoistureSensor::ambientBucket(uint16_t ambientNir) const
+{
+    // 增益系数x2（0.5x档为1），即1<<增益枚举值；
+    // 默认设定的归一分母：128x增益x2 = 256，ATIME 100 → 101
+    uint16_t gainX2 = (uint16_t)1 << (uint8_t)_gain;
+    uint32_t norm = ((uint32_t)ambientNir * 256UL * 101UL) /
+                    ((uint32_t)gainX2 * (uint32_t)(_integrationTime + 1));
+
+    if (norm < 256)
+    {
+        return 0;
+    }
+    if (norm < 2048)
+    {
+        return 1;
+    }
+    if (norm < 16384)
+    {
+        return 2;
+    }
+    return 3;
+}
+
+// 测量开始前用缓存的收敛设定做种子
+// 以上次测量的光照档位做预测：光照条件通常在相邻测量间不变
+void MoistureSensor::seedTunedSettings()
+{
+    if (!_autoTune || _lastAmbientBucket < 0)
+    {
+        return;
+    }
+
+    const TunedSettings &tuned = _tunedCache[_lastAmbientBucket];
+    if (!tuned.valid)
+    {
+        return;
+    }
+
+    if (tuned.gain != _gain)
+    {
+        setGain(tuned.gain);
+    }
+    if (tuned.atime != _integrationTime)
+    {
+        setIntegrationTime(tuned.atime);
+    }
+}
+
+// 把当前设定写入当前光照档位的缓存槽
+void MoistureSensor::cacheTunedSettings()
+{
+    if (_lastAmbientBucket < 0)
+    {
+        return;
+    }
+
+    TunedSettings &tuned = _tunedCache[_lastAmbientBucket];
+    tuned.gain = _gain;
+    tuned.atime = _integrationTime;
+    tuned.valid = true;
+}
+
+// 基于本次反射读数的峰值余量收敛设定：
+// 目标是让峰值落在ADC量程的中上段——远离饱和又保住分辨率。
+// 优先调增益（无积分时间代价），增益到边界后再动积分时间。
+// 调整在下次测量生效，本次结果不受影响
+void MoistureSensor::autotune(const uint16_t *readings)
+{
+    if (!_autoTune)
+    {
+        return;
+    }
+
+    uint16_t peak = 0;
+    for (int i = 0; i < 12; i++)
+    {
+        if (readings[i] > peak)
+        {
+            peak = readings[i];
+        }
+    }
+
+    if (peak > TUNE_TARGET_HIGH)
+    {
+        as7341_gain_t lower = decreaseGain(_gain);
+        if (lower != _gain)
+        {
+            setGain(lower);
+        }
+        else if (_integrationTime > TUNE_ATIME_MIN)
+        {
+            uint16_t halved = _integrationTime / 2;
+            setIntegrationTime(halved > TUNE_ATIME_MIN ? halved : TUNE_ATIME_MIN);
+        }
+    }
+    else if (peak < TUNE_TARGET_LOW)
+    {
+        as7341_gain_t higher = increaseGain(_gain);
+        if (higher != _gain)
+        {
+            setGain(higher);
+        }
+        else if (_integrationTime < TUNE_ATIME_MAX)
+        {
+            uint16_t doubled = _integrationTime * 2;
+            setIntegrationTime(doubled < TUNE_ATIME_MAX ? doubled : TUNE_ATIME_MAX);
+        }
+    }
+
+    cacheTunedSettings();
+}
+
+void MoistureSensor::setHistory(TelemetryHistory *history)
+{
+    _history = history;
+}
+
 void MoistureSensor::setIRLED(bool state)
 {
     // 保存状态
@@ -369,49 +784,68 @@ void MoistureSensor::setIRLED(bool state)
     digitalWrite(_irledPin, state ? HIGH : LOW);
 
     // 发布LED状态到"irled/status"主题
-    _pubsub->publish("irled/status", state ? "on" : "off");
+    _pubsub->publish(F("irled/status"), state ? "on" : "off");
 
-    // LED稳定延迟（10ms）
-    delay(10);
+    // 稳定等待由调用方负责：异步测量在状态机中等待，
+    // 阻塞式校准路径显式delay
 }
 
 void MoistureSensor::publishMeasurement(const MeasurementResult &result)
 {
-    // 构建JSON格式消息
-    char payload[128];
-    snprintf(payload, sizeof(payload),
-             "{\"paper_present\":%s,\"moisture\":%.1f,\"is_dry\":%s,\"timestamp\":%lu}",
-             result.paperPresent ? "true" : "false",
-             result.moisturePercent,
-             (result.moisturePercent < 5.0) ? "true" : "false",
-             millis());
+    // 构建JSON格式消息（湿度以0.1%整数格式化，避开浮点printf）
+    long moisture_x10 = (long)(result.moisturePercent * 10.0 + 0.5);
 
-    _pubsub->publish("moisture/data", payload);
+    // 有纸时将测量结果写入遥测历史缓冲
+    if (_history != nullptr && result.paperPresent)
+    {
+        _history->recordMoisture((uint16_t)moisture_x10);
+    }
+
+    char payload[128];
+    snprintf_P(payload, sizeof(payload),
+               PSTR("{\"paper_present\":%s,\"moisture\":%ld.%ld,\"is_dry\":%s,\"timestamp\":%lu}"),
+               result.paperPresent ? "true" : "false",
+               moisture_x10 / 10, moisture_x10 % 10,
+               (moisture_x10 < 50) ? "true" : "false",
+               millis());
+
+    _pubsub->publish(F("moisture/data"), payload);
 }
 
 void MoistureSensor::publishError(const char *error)
 {
     char payload[128];
-    snprintf(payload, sizeof(payload), "{\"error\":\"%s\"}", error);
-    _pubsub->publish("moisture/error", payload);
+    snprintf_P(payload, sizeof(payload), PSTR("{\"error\":\"%s\"}"), error);
+    _pubsub->publish(F("moisture/error"), payload);
+}
+
+// PROGMEM错误文案重载：复制到栈缓冲后走JSON组装路径
+void MoistureSensor::publishError(const __FlashStringHelper *error)
+{
+    char text[64];
+    strncpy_P(text, reinterpret_cast<PGM_P>(error), sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    publishError(text);
 }
 
 void MoistureSensor::publishCalibration(const char *type, float baseline, bool success)
 {
+    long baseline_x10 = (long)(baseline * 10.0 + 0.5);
     char payload[128];
-    snprintf(payload, sizeof(payload),
-             "{\"type\":\"%s\",\"baseline\":%.1f,\"success\":%s}",
-             type, baseline, success ? "true" : "false");
-    _pubsub->publish("moisture/calibration", payload);
+    snprintf_P(payload, sizeof(payload),
+               PSTR("{\"type\":\"%s\",\"baseline\":%ld.%ld,\"success\":%s}"),
+               type, baseline_x10 / 10, baseline_x10 % 10,
+               success ? "true" : "false");
+    _pubsub->publish(F("moisture/calibration"), payload);
 }
 
 void MoistureSensor::publishConfig()
 {
     char payload[128];
-    snprintf(payload, sizeof(payload),
-             "{\"gain\":%d,\"integration_time\":%d}",
-             _gain, _integrationTime);
-    _pubsub->publish("moisture/config/response", payload);
+    snprintf_P(payload, sizeof(payload),
+               PSTR("{\"gain\":%d,\"integration_time\":%d,\"autotune\":%s}"),
+               _gain, _integrationTime, _autoTune ? "true" : "false");
+    _pubsub->publish(F("moisture/config/response"), payload);
 }
 
 bool MoistureSensor::handleSaturation(uint16_t *readings)
@@ -424,14 +858,15 @@ bool MoistureSensor::handleSaturation(uint16_t *readings)
 
         if (newGain != _gain)
         {
-            // 成功降低增益
+            // 成功降低增益，同步写入当前光照档位的缓存
             setGain(newGain);
+            cacheTunedSettings();
             return true; // 需要重新测量
         }
         else
         {
             // 已经是最低增益，无法进一步降低
-            publishError("Sensor saturated at minimum gain");
+            publishError(F("Sensor saturated at minimum gain"));
             return false; // 无法调整，但不重试
         }
     }
@@ -471,16 +906,45 @@ as7341_gain_t MoistureSensor::decreaseGain(as7341_gain_t currentGain)
     }
 }
 
+as7341_gain_t MoistureSensor::increaseGain(as7341_gain_t currentGain)
+{
+    // 提升增益到下一个较高的级别
+    switch (currentGain)
+    {
+    case AS7341_GAIN_0_5X:
+        return AS7341_GAIN_1X;
+    case AS7341_GAIN_1X:
+        return AS7341_GAIN_2X;
+    case AS7341_GAIN_2X:
+        return AS7341_GAIN_4X;
+    case AS7341_GAIN_4X:
+        return AS7341_GAIN_8X;
+    case AS7341_GAIN_8X:
+        return AS7341_GAIN_16X;
+    case AS7341_GAIN_16X:
+        return AS7341_GAIN_32X;
+    case AS7341_GAIN_32X:
+        return AS7341_GAIN_64X;
+    case AS7341_GAIN_64X:
+        return AS7341_GAIN_128X;
+    case AS7341_GAIN_128X:
+        return AS7341_GAIN_256X;
+    case AS7341_GAIN_256X:
+        return AS7341_GAIN_512X;
+    case AS7341_GAIN_512X:
+        return AS7341_GAIN_512X; // 已经是最高增益
+    default:
+        return currentGain;
+    }
+}
+
 // 静态回调函数
 void MoistureSensor::measureCallback(const char *topic, const char *payload)
 {
     if (_instance)
     {
-        MeasurementResult result = _instance->measure();
-        if (result.isValid)
-        {
-            _instance->publishMeasurement(result);
-        }
+        // 启动异步测量，结果由loop()状态机完成后发布
+        _instance->startMeasurement();
     }
 }
 
@@ -502,7 +966,7 @@ void MoistureSensor::calibrateCallback(const char *topic, const char *payload)
         }
         else
         {
-            _instance->publishError("Invalid calibration type. Use 'dry' or 'wet'");
+            _instance->publishError(F("Invalid calibration type. Use 'dry' or 'wet'"));
         }
     }
 }
@@ -581,6 +1045,19 @@ void MoistureSensor::configCallback(const char *topic, const char *payload)
             }
         }
 
+        // 解析autotune参数（手工固定增益前先关闭自动调谐，
+        // 否则下次测量会被收敛逻辑改回去）
+        const char *tuneStr = strstr(payload, "\"autotune\"");
+        if (tuneStr != nullptr)
+        {
+            const char *colonPos = strchr(tuneStr, ':');
+            if (colonPos != nullptr)
+            {
+                _instance->setAutoTune(strstr(colonPos, "true") != nullptr ||
+                                       atoi(colonPos + 1) != 0);
+            }
+        }
+
         // 发布配置响应到"moisture/config/response"
         _instance->publishConfig();
     }
@@ -607,5 +1084,5 @@ void MoistureSensor::irledGetCallback(const char *topic, const char *payload)
     if (_instance == nullptr)
         return;
 
-    _instance->_pubsub->publish("irled/status", _instance->_irledState ? "on" : "off");
+    _instance->_pubsub->publish(F("irled/status"), _instance->_irledState ? "on" : "off");
 }
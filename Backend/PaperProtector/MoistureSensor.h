@@ -5,6 +5,18 @@
 #include <Adafruit_AS7341.h>
 #include "SerialPubSub.h"
 
+class TelemetryHistory;
+
+// 异步测量状态机状态
+enum MoistureMeasureState
+{
+    MEASURE_IDLE,            // 空闲
+    MEASURE_AMBIENT_SETTLE,  // LED关闭后等待稳定
+    MEASURE_AMBIENT_READING, // 环境光积分进行中
+    MEASURE_LED_SETTLE,      // LED打开后等待稳定
+    MEASURE_LED_READING      // 反射光积分进行中
+};
+
 class MoistureSensor
 {
 public:
@@ -25,17 +37,31 @@ public:
         bool isValid;       // 校准数据有效性
     };
 
+    // EEPROM中的校准记录（轮转写入多个槽位做磨损均衡）
+    struct CalibrationRecord
+    {
+        uint16_t magic;     // 固定标识，区分未写入的空槽
+        uint16_t sequence;  // 写入序号，最大者为最新记录
+        float dryBaseline;  // 干燥基准
+        float wetBaseline;  // 湿润基准
+        uint8_t flags;      // bit0 = isValid
+        uint8_t checksum;   // 前面所有字节的异或校验
+    };
+
     // 构造函数
     MoistureSensor(SerialPubSub *pubsub, int irledPin);
 
     // 初始化传感器
     bool begin();
 
-    // 主循环处理
+    // 主循环处理（驱动异步测量状态机）
     void loop();
 
-    // 执行测量（核心函数）
-    MeasurementResult measure();
+    // 启动一次异步测量（核心入口，结果通过moisture/data发布）
+    bool startMeasurement();
+
+    // 测量是否正在进行
+    bool isMeasuring() const;
 
     // 校准功能
     bool calibrateDry(); // 校准干燥纸张
@@ -44,27 +70,68 @@ public:
     // 配置参数
     void setGain(as7341_gain_t gain);
     void setIntegrationTime(uint16_t time);
+    void setAutoTune(bool enabled);
+
+    // 挂接遥测历史缓冲（可选，发布的测量结果会同时写入）
+    void setHistory(TelemetryHistory *history);
 
 private:
     SerialPubSub *_pubsub;
     Adafruit_AS7341 _sensor;
+    TelemetryHistory *_history;
     int _irledPin;    // Arduino数字引脚，用于控制外部IRLED
     bool _irledState; // IR LED 当前状态
 
     // 校准数据
     CalibrationData _calibration;
 
+    // EEPROM持久化配置
+    static const int EEPROM_CALIB_BASE = 0;    // 校准区起始地址
+    static const int EEPROM_CALIB_SLOTS = 8;   // 轮转槽位数
+    static const uint16_t CALIB_MAGIC = 0x4D43; // 'MC'
+    int _calibSlot;          // 最近一次写入的槽位
+    uint16_t _calibSequence; // 最近一次写入的序号
+
     // 测量频率限制
     unsigned long _lastMeasurementTime;
     static const unsigned long MIN_MEASUREMENT_INTERVAL = 500; // 最小测量间隔(ms)
 
+    // 异步测量状态机
+    MoistureMeasureState _measureState; // 当前状态
+    unsigned long _stateEnteredTime;    // 进入当前状态的时刻(ms)
+    int _measureRetry;                  // 当前测量已重试次数
+    float _pendingAmbient;              // 本次测量的环境光强度
+    uint16_t _measureReadings[12];      // 通道读数缓冲区
+    uint16_t _ambientReadings[12];      // 环境光阶段的全通道读数
+    static const unsigned long LED_SETTLE_MS = 10; // LED切换后的稳定时间
+
     // 传感器配置
     as7341_gain_t _gain;
     uint16_t _integrationTime;
 
+    // 自动调谐：按环境光档位缓存收敛后的增益/积分时间
+    struct TunedSettings
+    {
+        as7341_gain_t gain; // 该光照档位收敛的增益
+        uint16_t atime;     // 该光照档位收敛的积分时间
+        bool valid;         // 槽位是否已写入
+    };
+    static const int TUNE_BUCKETS = 4;          // 光照分档数（暗/弱/亮/强光）
+    static const uint16_t TUNE_TARGET_LOW = 8000;   // 峰值低于此值则提升灵敏度
+    static const uint16_t TUNE_TARGET_HIGH = 48000; // 峰值高于此值则降低灵敏度
+    static const uint16_t TUNE_ATIME_MIN = 29;      // 积分时间下限(ATIME)
+    static const uint16_t TUNE_ATIME_MAX = 255;     // 积分时间上限(ATIME)
+    TunedSettings _tunedCache[TUNE_BUCKETS];
+    int _lastAmbientBucket; // 最近一次测量的环境光档位，-1表示未知
+    bool _autoTune;         // 自动调谐开关
+
     // 重试配置
+    // 通信失败与设定切换分开计数：换增益/积分时间重来一趟是
+    // 调谐的正常路径，不该吃掉通信故障的重试配额
     static const int MAX_RETRIES = 3;
+    static const int MAX_TUNE_RESTARTS = 4;
     static const int RETRY_DELAY_MS = 50;
+    int _measureTuneRestart; // 本次测量因设定切换已重启的次数
 
     // 饱和检测阈值（AS7341的16位ADC最大值）
     static const uint16_t SATURATION_THRESHOLD = 65000; // 接近65535的饱和值
@@ -72,18 +139,38 @@ private:
     // 增益调整辅助方法
     bool handleSaturation(uint16_t *readings);
     as7341_gain_t decreaseGain(as7341_gain_t currentGain);
+    as7341_gain_t increaseGain(as7341_gain_t currentGain);
+
+    // 自动调谐辅助方法
+    int ambientBucket(uint16_t ambientNir) const;
+    void seedTunedSettings();
+    void cacheTunedSettings();
+    void autotune(const uint16_t *readings);
 
     // 内部方法
-    void setIRLED(bool state); // 集中控制LED并发布状态
+    void setIRLED(bool state); // 集中控制LED并发布状态（不再内嵌延迟）
+    void enterMeasureState(MoistureMeasureState state);
+    void retryMeasurement();
+    void restartMeasurement();
+    void failMeasurement(const char *error);
+    void failMeasurement(const __FlashStringHelper *error);
+    void finishMeasurement(float reflectedIntensity, float ambientIntensity);
     float readNIRIntensity();
     float readAmbientIntensity();
     bool detectPaper(float intensity, float ambient);
     float calculateMoisture(float intensity);
+    void analyzeSpectrum(const uint16_t *ledReadings, const uint16_t *ambientReadings);
     void publishMeasurement(const MeasurementResult &result);
     void publishError(const char *error);
+    void publishError(const __FlashStringHelper *error);
     void publishCalibration(const char *type, float baseline, bool success);
     void publishConfig();
 
+    // EEPROM校准持久化
+    bool loadCalibration();
+    void saveCalibration();
+    static uint8_t recordChecksum(const CalibrationRecord &record);
+
     // 静态回调
     static void measureCallback(const char *topic, const char *payload);
     static void calibrateCallback(const char *topic, const char *payload);
@@ -3,13 +3,19 @@
 #include "FanController.h"
 #include "DHT22Sensor.h"
 #include "Heater.h"
+#include "ControlLoop.h"
+#include "LoopProfiler.h"
+#include "TaskScheduler.h"
+#include "TelemetryHistory.h"
 // #include "MoistureSensor.h"  // 暂时不使用 AS7341 和 IR LED
 
 #define DIR_PIN 2
 #define STEP_PIN 3
-#define FAN_PIN 5
+// 风扇/加热器在Timer1的引脚9/10上：setupFastPwm把Timer1配成
+// 25kHz载波消除啸叫，而Timer0的引脚5/6不能重配（会破坏millis）
+#define FAN_PIN 9
 #define DHT_PIN 8
-#define HEATER_PIN 6
+#define HEATER_PIN 10
 // #define IRLED_PIN 4  // 暂时不使用
 
 SerialPubSub pubsub;
@@ -22,60 +28,359 @@ DHT22Sensor dhtSensor(&pubsub, DHT_PIN);
 
 Heater heater(&pubsub, HEATER_PIN);
 
+ControlLoop controlLoop(&pubsub, &dhtSensor, &heater, &fan);
+
+// 遥测历史：断线重连后主机通过dht/history批量回填图表
+TelemetryHistory history(&pubsub);
+
 // MoistureSensor moistureSensor(&pubsub, IRLED_PIN);  // 暂时不使用
 
-void setup()
+// 主循环耗时剖析：摘要周期发布在system/loopstats
+LoopProfiler profiler(&pubsub);
+int profPubsub = -1;
+int profStepper = -1;
+int profFan = -1;
+int profDht = -1;
+int profHeater = -1;
+int profControl = -1;
+int profHistory = -1;
+
+// 协作式调度器：模块按周期+优先级注册，只有到期的任务才被分发。
+// 串口和步进为0周期（每轮执行），其余按各自内部节奏给定周期，
+// DHT等200ms节奏的模块不再每轮白查一次millis()。
+// 每任务的调度延迟/错过统计发布在system/tasks
+TaskScheduler scheduler(&pubsub);
+
+// 任务包装：执行模块loop并记录剖析采样
+void taskPubsub()
 {
-    pubsub.begin(9600);
+    pubsub.loop();
+    profiler.sample(profPubsub);
+}
 
-    delay(1000);
+void taskStepper()
+{
+    stepper.loop();
+    profiler.sample(profStepper);
+}
 
-    while (Serial.available())
+void taskFan()
+{
+    fan.loop();
+    profiler.sample(profFan);
+}
+
+void taskDht()
+{
+    dhtSensor.loop();
+    profiler.sample(profDht);
+}
+
+void taskHeater()
+{
+    heater.loop();
+    profiler.sample(profHeater);
+}
+
+void taskControl()
+{
+    controlLoop.loop();
+    profiler.sample(profControl);
+}
+
+void taskHistory()
+{
+    history.loop();
+    profiler.sample(profHistory);
+}
+
+// 分阶段启动：setup()只拉起串口，各模块的begin()作为
+// 启动任务在loop()中逐个执行，每个阶段完成后在system/boot上报。
+// 主机复位串口后firmware立即可解析命令，不再有~2秒的启动停顿
+enum BootStage
+{
+    BOOT_STEPPER,
+    BOOT_FAN,
+    BOOT_DHT,
+    BOOT_HEATER,
+    BOOT_CONTROL,
+    BOOT_HISTORY,
+    // BOOT_MOISTURE,  // 暂时不使用 AS7341 传感器和 IR LED
+    BOOT_DONE
+};
+
+BootStage bootStage = BOOT_STEPPER;
+
+// 每次执行一个模块的初始化并上报就绪状态
+void bootNextModule()
+{
+    switch (bootStage)
     {
-        Serial.read();
+    case BOOT_STEPPER:
+        stepper.begin();
+        pubsub.publish(F("system/boot"), F("stepper:ready"));
+        bootStage = BOOT_FAN;
+        break;
+
+    case BOOT_FAN:
+        fan.begin();
+        pubsub.publish(F("system/boot"), F("fan:ready"));
+        bootStage = BOOT_DHT;
+        break;
+
+    case BOOT_DHT:
+        dhtSensor.begin();
+        pubsub.publish(F("system/boot"), F("dht:ready"));
+        bootStage = BOOT_HEATER;
+        break;
+
+    case BOOT_HEATER:
+        heater.begin();
+        pubsub.publish(F("system/boot"), F("heater:ready"));
+        bootStage = BOOT_CONTROL;
+        break;
+
+    case BOOT_CONTROL:
+        controlLoop.begin();
+        pubsub.publish(F("system/boot"), F("control:ready"));
+        bootStage = BOOT_HISTORY;
+        break;
+
+    case BOOT_HISTORY:
+        history.begin();
+        dhtSensor.setHistory(&history);
+        pubsub.publish(F("system/boot"), F("history:ready"));
+
+        // 暂时不使用 AS7341 传感器和 IR LED
+        // bootStage = BOOT_MOISTURE;
+        // break;
+
+    // case BOOT_MOISTURE:
+    //     moistureSensor.begin();
+    //     moistureSensor.setHistory(&history);
+    //     pubsub.publish(F("system/boot"), F("moisture:ready"));
+
+        // 全部模块就绪
+        pubsub.publish(F("system/status"), F("initialized"));
+        bootStage = BOOT_DONE;
+        break;
+
+    case BOOT_DONE:
+        break;
+    }
+}
+
+// 聚合状态快照：主机重连后用一次system/state查询替代
+// fan/query、heater/query、dht/query、motor/position/get的多次往返，
+// 全部取各模块的缓存状态，不触发任何新的传感器读取
+void stateQueryCallback(const char *topic, const char *payload)
+{
+    long rev_x100 = stepper.positionRevolutionsX100();
+    long mm_x100 = stepper.positionMmX100();
+
+    // DHT的EMA缓存值（无有效读数时为nan，由主机侧判空）
+    char tempStr[8] = "nan";
+    char humStr[8] = "nan";
+    if (dhtSensor.hasReading())
+    {
+        dtostrf(dhtSensor.getTemperature(), 0, 1, tempStr);
+        dtostrf(dhtSensor.getHumidity(), 0, 1, humStr);
+    }
+
+    char snapshot[96];
+    snprintf_P(snapshot, sizeof(snapshot),
+               PSTR("fan:%d,heater:%d,rev:%ld.%02ld,mm:%ld.%02ld,temp:%s,hum:%s"),
+               fan.getCurrentSpeed(), heater.getCurrentPower(),
+               rev_x100 / 100, abs(rev_x100 % 100),
+               mm_x100 / 100, abs(mm_x100 % 100),
+               tempStr, humStr);
+    // moisture字段在AS7341重新启用后随moistureSensor一并加入
+    pubsub.publish(F("system/state"), snapshot);
+}
+
+// 基准测试固件：定义PP_BENCH（此处或编译命令行）后，
+// 启动完成时运行一轮微基准并在bench/results上报，替代正常工作循环。
+// 用于硬件在环回归检查：解析吞吐、发布落线延迟、运动期主循环抖动
+// #define PP_BENCH
+
+#ifdef PP_BENCH
+
+bool benchDone = false;
+
+// 基准用空回调：只为让解析路径走完完整的分发流程
+void benchNullCallback(const char *topic, const char *payload)
+{
+    (void)topic;
+    (void)payload;
+}
+
+// 基准1：parseMessage吞吐（次/秒），含哈希、查表和回调分发
+unsigned long benchParseThroughput()
+{
+    const int ITERATIONS = 2000;
+
+    pubsub.subscribe(F("bench/null"), benchNullCallback);
+
+    unsigned long start = micros();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        pubsub.benchParseMessage("bench/null:0");
     }
+    unsigned long elapsed = micros() - start;
 
-    pubsub.publish("system/status", "ready");
+    pubsub.unsubscribe(F("bench/null"));
 
-    stepper.begin();
+    if (elapsed == 0)
+    {
+        return 0;
+    }
+    return (unsigned long)(((uint32_t)ITERATIONS * 1000000UL) / elapsed);
+}
 
-    fan.begin();
+// 基准2：publish到串口落线的平均延迟（微秒）
+// 每次publish后立即排空队列并等待UART发送完成。
+// 主题须落在高优先级类（"config"子串）：普通类令牌桶上限10，
+// 第11次起publish只入队不落线，测出来的就不再是落线延迟
+unsigned long benchPublishLatency()
+{
+    const int ITERATIONS = 20;
 
-    dhtSensor.begin();
+    unsigned long total = 0;
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        unsigned long start = micros();
+        pubsub.publish(F("bench/config"), F("0123456789012345"));
+        pubsub.loop();
+        Serial.flush();
+        total += micros() - start;
+    }
+    return total / ITERATIONS;
+}
 
-    heater.begin();
+// 基准3：运动期间主循环的调度抖动
+// 执行一段短行程，记录相邻两次stepper.loop()调用间隔的最大值，
+// 间隔尖峰直接对应步进脉冲的最大定时误差
+void benchStepJitter(unsigned long *meanUs, unsigned long *maxUs)
+{
+    stepper.rotate(0.5);
 
-    // 暂时不使用 AS7341 传感器和 IR LED
-    // // 清空缓冲区
-    // while (Serial.available())
-    // {
-    //     Serial.read();
-    // }
+    unsigned long last = micros();
+    unsigned long maxDelta = 0;
+    unsigned long total = 0;
+    unsigned long count = 0;
 
-    // // 最后初始化可能阻塞的传感器
-    // moistureSensor.begin();
+    while (stepper.isBusy())
+    {
+        stepper.loop();
+
+        unsigned long now = micros();
+        unsigned long delta = now - last;
+        last = now;
 
-    // // 再次清空缓冲区
-    // while (Serial.available())
-    // {
-    //     Serial.read();
-    // }
+        if (delta > maxDelta)
+        {
+            maxDelta = delta;
+        }
+        total += delta;
+        count++;
+    }
 
-    // 发布初始状态
-    pubsub.publish("system/status", "initialized");
+    // 排空运动完成时发布的状态消息
+    pubsub.loop();
+
+    *meanUs = (count > 0) ? (total / count) : 0;
+    *maxUs = maxDelta;
 }
 
-void loop()
+// 运行全部基准并上报结果
+void runBenchmarks()
 {
+    pubsub.publish(F("bench/status"), F("running"));
     pubsub.loop();
 
-    stepper.loop();
+    unsigned long parseOps = benchParseThroughput();
+    unsigned long publishUs = benchPublishLatency();
 
-    fan.loop();
+    unsigned long jitterMean = 0;
+    unsigned long jitterMax = 0;
+    benchStepJitter(&jitterMean, &jitterMax);
 
-    dhtSensor.loop();
+    char results[96];
+    snprintf_P(results, sizeof(results),
+               PSTR("parse_ops:%lu,publish_us:%lu,loop_mean_us:%lu,loop_max_us:%lu"),
+               parseOps, publishUs, jitterMean, jitterMax);
+    pubsub.publish(F("bench/results"), results);
+    pubsub.publish(F("bench/status"), F("done"));
+}
 
-    heater.loop();
+#endif // PP_BENCH
+
+void setup()
+{
+    pubsub.begin(115200);
+
+    // 丢弃上电瞬间串口线上的噪声字节
+    while (Serial.available())
+    {
+        Serial.read();
+    }
+
+    // 串口可以解析命令即宣告就绪，模块初始化在loop()中分阶段完成
+    pubsub.publish(F("system/status"), F("ready"));
+
+    // 聚合状态查询（沿用motor/position/get→motor/position的命名约定）
+    pubsub.subscribe(F("system/state/get"), stateQueryCallback);
+
+    // 注册剖析槽位（缩写出现在system/loopstats摘要中）
+    profPubsub = profiler.addModule("ps");
+    profStepper = profiler.addModule("st");
+    profFan = profiler.addModule("fa");
+    profDht = profiler.addModule("dh");
+    profHeater = profiler.addModule("ht");
+    profControl = profiler.addModule("cl");
+    profHistory = profiler.addModule("hi");
+
+    // 注册调度任务：串口和步进每轮执行（步进脉冲是微秒级定时），
+    // 风扇/加热按10ms斜坡步长、DHT按10ms（中断捕获的起始脉冲和
+    // 解码阶段需要毫秒级推进）、控制回路按100ms（内部1s周期）轮询；
+    // 优先级沿用原调用链顺序
+    scheduler.addTask("ps", taskPubsub, 0, 0);
+    scheduler.addTask("st", taskStepper, 0, 1);
+    scheduler.addTask("fa", taskFan, 10, 2);
+    scheduler.addTask("ht", taskHeater, 10, 2);
+    scheduler.addTask("dh", taskDht, 10, 3);
+    scheduler.addTask("cl", taskControl, 100, 4);
+    // 历史回传推进：10ms一轮，和115200波特率下暂存缓冲
+    // ~8ms排空一块的节奏相称
+    scheduler.addTask("hi", taskHistory, 10, 5);
+}
+
+void loop()
+{
+    // 启动阶段：只维持串口并逐个拉起模块，暂不进入调度器
+    if (bootStage != BOOT_DONE)
+    {
+        pubsub.loop();
+        bootNextModule();
+        return;
+    }
+
+#ifdef PP_BENCH
+    // 基准固件：启动完成后跑一轮基准，之后只维持串口可用
+    pubsub.loop();
+    if (!benchDone)
+    {
+        runBenchmarks();
+        benchDone = true;
+    }
+    return;
+#endif
+
+    profiler.startFrame();
+
+    // 模块调用链交给调度器：只分发到期任务
+    // （moistureSensor任务在AS7341重新启用后一并注册）
+    scheduler.loop();
 
-    // moistureSensor.loop();  // 暂时不使用
+    profiler.endFrame();
 }
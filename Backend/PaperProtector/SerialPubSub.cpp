@@ -1,12 +1,48 @@
 #include "SerialPubSub.h"
 
+SerialPubSub *SerialPubSub::_instance = nullptr;
+
 SerialPubSub::SerialPubSub()
 {
     bufferIndex = 0;
+    _binaryMode = false;
+    _binaryTopicCount = 0;
+    _reliableMode = false;
+    _txReliableSeq = 0;
+    _rxExpectedSeq = 0;
+    _rxSeqSynced = false;
+    _rxHead = 0;
+    _rxTail = 0;
+    _txCount = 0;
+    _txSeqCounter = 0;
+    for (int i = 0; i < TX_QUEUE_SIZE; i++)
+    {
+        _txQueue[i].state = TX_SLOT_FREE;
+    }
+    for (int i = 0; i < TX_PRIORITY_CLASSES; i++)
+    {
+        _txTokens[i] = 0;
+    }
+    _lastTokenRefill = 0;
+    _txPendingLen = 0;
+    _txPendingOffset = 0;
+    _rxOverflowCount = 0;
+    _lineOverflowCount = 0;
+    _txBufferFullCount = 0;
+    _txDropCount = 0;
+    _lastPublishedRxOverflow = 0;
+    _lastPublishedLineOverflow = 0;
+    _lastPublishedTxBufferFull = 0;
+    _lastPublishedTxDrop = 0;
+    _lastDiagnosticsTime = 0;
+    _instance = this;
     for (int i = 0; i < MAX_SUBSCRIPTIONS; i++)
     {
         subscriptions[i].active = false;
-        subscriptions[i].topic[0] = '\0';
+        subscriptions[i].topic = nullptr;
+        subscriptions[i].hash = 0;
+        subscriptions[i].prefixLen = 0;
+        subscriptions[i].inFlash = false;
         subscriptions[i].callback = nullptr;
     }
     receiveBuffer[0] = '\0';
@@ -16,6 +52,111 @@ void SerialPubSub::begin(long baudRate)
 {
     Serial.begin(baudRate);
     bufferIndex = 0;
+
+    // 主机在收到system/status握手后可发送"system/binary:on"启用二进制帧
+    subscribe(F("system/binary"), binaryModeCallback);
+
+    // 可靠传输模式协商与主机侧重传请求
+    subscribe(F("system/reliable"), reliableModeCallback);
+    subscribe(F("system/nak"), nakCallback);
+}
+
+// 可靠传输模式协商回调
+void SerialPubSub::reliableModeCallback(const char *topic, const char *payload)
+{
+    if (_instance == nullptr || payload == nullptr)
+    {
+        return;
+    }
+
+    if (strcmp_P(payload, PSTR("on")) == 0)
+    {
+        // 先以普通格式确认，之后的所有行都带序号和CRC
+        _instance->sendMessage(F("system/reliable/status"), "on");
+        _instance->_reliableMode = true;
+        _instance->_txReliableSeq = 0;
+        _instance->_rxSeqSynced = false;
+        _instance->clearRetainedSlots();
+    }
+    else if (strcmp_P(payload, PSTR("off")) == 0)
+    {
+        _instance->_reliableMode = false;
+        _instance->clearRetainedSlots();
+        _instance->sendMessage(F("system/reliable/status"), "off");
+    }
+}
+
+// 释放队列中全部重传保留槽（模式切换时序号重新开始计数）
+void SerialPubSub::clearRetainedSlots()
+{
+    for (int i = 0; i < TX_QUEUE_SIZE; i++)
+    {
+        if (_txQueue[i].state == TX_SLOT_RETAINED)
+        {
+            _txQueue[i].state = TX_SLOT_FREE;
+        }
+    }
+}
+
+// 主机侧重传请求：payload为缺失的起始序号
+// 从该序号起按序重发窗口内仍保留的消息（go-back-N）
+void SerialPubSub::nakCallback(const char *topic, const char *payload)
+{
+    if (_instance != nullptr && payload != nullptr)
+    {
+        _instance->handleNak(payload);
+    }
+}
+
+void SerialPubSub::handleNak(const char *payload)
+{
+    uint8_t wanted = (uint8_t)atoi(payload);
+
+    for (int offset = 0; offset < RELIABLE_WINDOW_SIZE; offset++)
+    {
+        uint8_t seq = (uint8_t)(wanted + offset);
+        for (int i = 0; i < TX_QUEUE_SIZE; i++)
+        {
+            if (_txQueue[i].state == TX_SLOT_RETAINED && _txQueue[i].rseq == seq)
+            {
+                sendReliableLine(_txQueue[i].topic, _txQueue[i].payload, seq);
+                break;
+            }
+        }
+    }
+}
+
+// 二进制模式协商回调
+void SerialPubSub::binaryModeCallback(const char *topic, const char *payload)
+{
+    if (_instance == nullptr || payload == nullptr)
+    {
+        return;
+    }
+
+    if (strcmp_P(payload, PSTR("on")) == 0)
+    {
+        // 先以文本协议确认，再切换，保证主机能解析应答
+        _instance->sendMessage(F("system/binary/status"), "on");
+        _instance->setBinaryMode(true);
+    }
+    else if (strcmp_P(payload, PSTR("off")) == 0)
+    {
+        _instance->setBinaryMode(false);
+        _instance->sendMessage(F("system/binary/status"), "off");
+    }
+}
+
+void SerialPubSub::setBinaryMode(bool enabled)
+{
+    _binaryMode = enabled;
+    // 每次启用都清空注册表，重新协商时主机会重新收到全部注册帧
+    _binaryTopicCount = 0;
+}
+
+bool SerialPubSub::binaryMode() const
+{
+    return _binaryMode;
 }
 
 void SerialPubSub::sendMessage(const char *topic, const char *payload)
@@ -33,13 +174,393 @@ void SerialPubSub::sendMessage(const char *topic, const char *payload)
         }
     }
 
-    Serial.print(topic);
-    Serial.print(':');
-    if (payload != nullptr)
+    // 二进制模式下改走帧格式发送
+    if (_binaryMode)
+    {
+        sendBinaryMessage(topic, payload);
+        return;
+    }
+
+    // 可靠模式：带序号和CRC发送。重传副本由drainTxQueue把已
+    // 发出的队列槽位转为RETAINED态来保留；此处的直发行（超长
+    // 负载或队列满的回退路径）没有副本，被NAK时主机回退到超时重发
+    if (_reliableMode)
+    {
+        uint8_t seq = _txReliableSeq++;
+        sendReliableLine(topic, payload, seq);
+        return;
+    }
+
+    // 组装完整的一行后非阻塞写出，减少Serial调用开销
+    char line[MAX_TOPIC_LENGTH + MAX_MESSAGE_LENGTH + 2];
+    int len = snprintf_P(line, sizeof(line), PSTR("%s:%s\n"),
+                         topic, (payload != nullptr) ? payload : "");
+    if (len > 0)
+    {
+        if (len >= (int)sizeof(line))
+        {
+            len = sizeof(line) - 1;
+        }
+        writeWire((const uint8_t *)line, (uint16_t)len);
+    }
+}
+
+void SerialPubSub::sendMessage(const __FlashStringHelper *topic, const char *payload)
+{
+    char topicBuf[MAX_TOPIC_LENGTH];
+    if (copyFlashTopic(topic, topicBuf))
+    {
+        sendMessage(topicBuf, payload);
+    }
+}
+
+// 续写暂存缓冲中尚未发出的字节（硬件缓冲有多少空间写多少）
+void SerialPubSub::flushTxPending()
+{
+    while (_txPendingOffset < _txPendingLen)
+    {
+        int room = Serial.availableForWrite();
+        if (room <= 0)
+        {
+            return;
+        }
+
+        uint16_t remaining = _txPendingLen - _txPendingOffset;
+        uint16_t chunk = (remaining < (uint16_t)room) ? remaining : (uint16_t)room;
+        Serial.write(_txPending + _txPendingOffset, chunk);
+        _txPendingOffset += chunk;
+    }
+
+    _txPendingLen = 0;
+    _txPendingOffset = 0;
+}
+
+// 非阻塞写出一行：只写硬件TX缓冲能立即容纳的部分，
+// 剩余字节进暂存缓冲由loop()续写，主循环不再被Serial.print卡住。
+// 暂存缓冲也放不下整段剩余时丢弃整行并计数——
+// 行不可截半，否则会污染文本协议的消息边界
+void SerialPubSub::writeWire(const uint8_t *data, uint16_t length)
+{
+    flushTxPending();
+
+    uint16_t written = 0;
+
+    // 暂存为空时先直接写硬件缓冲
+    if (_txPendingLen == 0)
+    {
+        int room = Serial.availableForWrite();
+        if (room > 0)
+        {
+            written = (length < (uint16_t)room) ? length : (uint16_t)room;
+            Serial.write(data, written);
+        }
+        if (written == length)
+        {
+            return;
+        }
+        // 硬件缓冲写满，剩余部分转入暂存
+        _txBufferFullCount++;
+    }
+
+    // 压实暂存缓冲后追加剩余字节
+    uint16_t remaining = length - written;
+    if (_txPendingOffset > 0)
     {
-        Serial.print(payload);
+        memmove(_txPending, _txPending + _txPendingOffset,
+                _txPendingLen - _txPendingOffset);
+        _txPendingLen -= _txPendingOffset;
+        _txPendingOffset = 0;
+    }
+
+    if ((uint16_t)(TX_PENDING_SIZE - _txPendingLen) < remaining)
+    {
+        // 只有行首已上线时才必须写完（截断会破坏分帧），
+        // 此时暂存必为空、整行必定放得下；未写出的行整条丢弃
+        _txDropCount++;
+        return;
+    }
+
+    memcpy(_txPending + _txPendingLen, data + written, remaining);
+    _txPendingLen += remaining;
+}
+
+// 发送一条可靠模式行："topic:payload~<seq>~<CRC8十六进制>\n"
+// CRC覆盖主题到序号（最后一个'~'之前的全部字符）
+void SerialPubSub::sendReliableLine(const char *topic, const char *payload, uint8_t seq)
+{
+    char line[MAX_TOPIC_LENGTH + MAX_MESSAGE_LENGTH + 10];
+    int len = snprintf_P(line, sizeof(line), PSTR("%s:%s~%u"),
+                         topic, (payload != nullptr) ? payload : "", seq);
+    if (len < 0)
+    {
+        return;
+    }
+    if (len >= (int)sizeof(line) - 5)
+    {
+        len = sizeof(line) - 5;
+    }
+
+    uint8_t crc = crc8((const uint8_t *)line, (uint8_t)len);
+    len += snprintf_P(line + len, sizeof(line) - len, PSTR("~%02X\n"), crc);
+    writeWire((const uint8_t *)line, (uint16_t)len);
+}
+
+// 校验并剥离入站行的可靠模式后缀，返回是否应继续解析
+// 无后缀的行按旧格式照常接受（模式切换瞬间的过渡消息）；
+// CRC错误或序号缺口时发出system/nak请求主机重传，本行丢弃；
+// 已收过的重复序号（主机多余的重传）静默丢弃
+bool SerialPubSub::verifyReliableLine(char *message)
+{
+    char *crcSep = strrchr(message, '~');
+    if (crcSep == nullptr)
+    {
+        return true;
+    }
+
+    char *seqSep = nullptr;
+    for (char *p = message; p < crcSep; p++)
+    {
+        if (*p == '~')
+        {
+            seqSep = p;
+        }
+    }
+    if (seqSep == nullptr)
+    {
+        return true;
+    }
+
+    uint8_t received = (uint8_t)strtol(crcSep + 1, nullptr, 16);
+    uint8_t computed = crc8((const uint8_t *)message, (uint8_t)(crcSep - message));
+    char nakMsg[8];
+
+    if (received != computed)
+    {
+        snprintf_P(nakMsg, sizeof(nakMsg), PSTR("%u"), _rxExpectedSeq);
+        sendMessage(F("system/nak"), nakMsg);
+        return false;
+    }
+
+    uint8_t seq = (uint8_t)atoi(seqSep + 1);
+    *seqSep = '\0'; // 剥离后缀，message还原为"topic:payload"
+
+    if (!_rxSeqSynced)
+    {
+        _rxSeqSynced = true;
+        _rxExpectedSeq = (uint8_t)(seq + 1);
+        return true;
+    }
+
+    uint8_t diff = (uint8_t)(seq - _rxExpectedSeq);
+    if (diff == 0)
+    {
+        _rxExpectedSeq = (uint8_t)(seq + 1);
+        return true;
+    }
+    if (diff > 127)
+    {
+        return false; // 重复的旧序号
+    }
+
+    // 序号缺口：请求从期望序号起重传
+    snprintf_P(nakMsg, sizeof(nakMsg), PSTR("%u"), _rxExpectedSeq);
+    sendMessage(F("system/nak"), nakMsg);
+    return false;
+}
+
+// 按主题名划分发送优先级
+// */error及config/boot应答为高优先级；周期遥测主题为低优先级；
+// 其余状态类消息为普通优先级
+uint8_t SerialPubSub::classifyTopic(const char *topic)
+{
+    const char *slash = strrchr(topic, '/');
+    const char *leaf = (slash != nullptr) ? slash + 1 : topic;
+
+    if (strcmp(leaf, "error") == 0 || strcmp(leaf, "boot") == 0 ||
+        strstr(topic, "config") != nullptr)
+    {
+        return TX_PRIORITY_HIGH;
+    }
+
+    // 历史回传子树整体归一类：data（末段不满一块时入队）与end
+    // 必须同级才能保持FIFO，否则end标记会越过最后一块数据，
+    // 主机在记录没到齐前就关闭了传输
+    if (strstr(topic, "history") != nullptr)
+    {
+        return TX_PRIORITY_NORMAL;
+    }
+
+    if (strcmp(leaf, "data") == 0 || strcmp(leaf, "temperature") == 0 ||
+        strcmp(leaf, "humidity") == 0 || strcmp(leaf, "position") == 0 ||
+        strcmp(leaf, "state") == 0 || strcmp(leaf, "diagnostics") == 0)
+    {
+        return TX_PRIORITY_LOW;
+    }
+
+    return TX_PRIORITY_NORMAL;
+}
+
+// 将消息放入发送队列
+// 同主题已有排队消息时用新负载覆盖（去重）；
+// 负载超长或队列已满时退化为立即发送，不丢消息
+void SerialPubSub::enqueueMessage(const char *topic, const char *payload)
+{
+    if (payload == nullptr)
+    {
+        payload = "";
+    }
+
+    if (strlen(topic) >= MAX_TOPIC_LENGTH || strlen(payload) >= TX_QUEUE_PAYLOAD)
+    {
+        sendMessage(topic, payload);
+        return;
+    }
+
+    uint16_t hash = topicHash16(topic);
+    int freeSlot = -1;
+    int oldestRetained = -1;
+
+    // 去重：覆盖同主题的排队消息，保持其原有序号和优先级
+    // （RETAINED槽是已发出内容的历史副本，不参与去重覆盖）
+    for (int i = 0; i < TX_QUEUE_SIZE; i++)
+    {
+        if (_txQueue[i].state == TX_SLOT_FREE)
+        {
+            freeSlot = i;
+            continue;
+        }
+        if (_txQueue[i].state == TX_SLOT_RETAINED)
+        {
+            if (oldestRetained < 0 ||
+                (int8_t)(_txQueue[i].rseq - _txQueue[oldestRetained].rseq) < 0)
+            {
+                oldestRetained = i;
+            }
+            continue;
+        }
+        if (_txQueue[i].hash == hash && strcmp(_txQueue[i].topic, topic) == 0)
+        {
+            strcpy(_txQueue[i].payload, payload);
+            return;
+        }
+    }
+
+    // 无空闲槽时优先挤占最旧的重传保留槽：新消息比旧重传副本重要
+    if (freeSlot < 0)
+    {
+        freeSlot = oldestRetained;
+    }
+    if (freeSlot < 0)
+    {
+        sendMessage(topic, payload);
+        return;
+    }
+
+    strcpy(_txQueue[freeSlot].topic, topic);
+    strcpy(_txQueue[freeSlot].payload, payload);
+    _txQueue[freeSlot].hash = hash;
+    _txQueue[freeSlot].seq = _txSeqCounter++;
+    _txQueue[freeSlot].priority = classifyTopic(topic);
+    _txQueue[freeSlot].state = TX_SLOT_QUEUED;
+    _txCount++;
+}
+
+// 补充各优先级类的令牌（每100ms一次）
+// 普通类上限10、每周期+5（约50条/秒）；遥测类上限5、每周期+2（约20条/秒）
+// 高优先级类不经过令牌桶
+void SerialPubSub::refillTxTokens()
+{
+    unsigned long now = millis();
+    if (now - _lastTokenRefill < 100)
+    {
+        return;
+    }
+    _lastTokenRefill = now;
+
+    _txTokens[TX_PRIORITY_NORMAL] += 5;
+    if (_txTokens[TX_PRIORITY_NORMAL] > 10)
+    {
+        _txTokens[TX_PRIORITY_NORMAL] = 10;
+    }
+    _txTokens[TX_PRIORITY_LOW] += 2;
+    if (_txTokens[TX_PRIORITY_LOW] > 5)
+    {
+        _txTokens[TX_PRIORITY_LOW] = 5;
+    }
+}
+
+// 下发队列消息：高优先级先行，同优先级内按入队顺序
+// 令牌耗尽的类停留在队列中等下个补充周期，期间仍可被去重覆盖为最新值
+void SerialPubSub::drainTxQueue()
+{
+    refillTxTokens();
+
+    while (_txCount > 0)
+    {
+        // 暂存缓冲尚有积压时不再出队，消息留在队列里
+        // （仍可被去重覆盖为最新值），避免触发整行丢弃
+        if (_txPendingLen > _txPendingOffset)
+        {
+            break;
+        }
+
+        int best = -1;
+
+        for (int i = 0; i < TX_QUEUE_SIZE; i++)
+        {
+            if (_txQueue[i].state != TX_SLOT_QUEUED)
+            {
+                continue;
+            }
+            // 非高优先级类必须持有令牌
+            if (_txQueue[i].priority != TX_PRIORITY_HIGH &&
+                _txTokens[_txQueue[i].priority] == 0)
+            {
+                continue;
+            }
+            if (best < 0 ||
+                _txQueue[i].priority < _txQueue[best].priority ||
+                (_txQueue[i].priority == _txQueue[best].priority &&
+                 (int16_t)(_txQueue[i].seq - _txQueue[best].seq) < 0))
+            {
+                best = i;
+            }
+        }
+
+        // 剩余消息都在等待令牌
+        if (best < 0)
+        {
+            break;
+        }
+
+        sendMessage(_txQueue[best].topic, _txQueue[best].payload);
+        if (_txQueue[best].priority != TX_PRIORITY_HIGH)
+        {
+            _txTokens[_txQueue[best].priority]--;
+        }
+
+        // 可靠文本模式下槽位转为重传保留态（sendMessage刚用掉的
+        // 序号是_txReliableSeq-1），窗口之外的旧保留槽顺手释放
+        if (_reliableMode && !_binaryMode)
+        {
+            _txQueue[best].rseq = (uint8_t)(_txReliableSeq - 1);
+            _txQueue[best].state = TX_SLOT_RETAINED;
+            for (int i = 0; i < TX_QUEUE_SIZE; i++)
+            {
+                if (_txQueue[i].state == TX_SLOT_RETAINED &&
+                    (uint8_t)(_txQueue[best].rseq - _txQueue[i].rseq) >=
+                        RELIABLE_WINDOW_SIZE)
+                {
+                    _txQueue[i].state = TX_SLOT_FREE;
+                }
+            }
+        }
+        else
+        {
+            _txQueue[best].state = TX_SLOT_FREE;
+        }
+        _txCount--;
     }
-    Serial.print('\n');
 }
 
 bool SerialPubSub::publish(const char *topic, const char *payload)
@@ -48,7 +569,7 @@ bool SerialPubSub::publish(const char *topic, const char *payload)
     {
         return false;
     }
-    sendMessage(topic, payload);
+    enqueueMessage(topic, payload);
     return true;
 }
 
@@ -60,7 +581,7 @@ bool SerialPubSub::publish(const char *topic, int value)
     }
     char buffer[12]; // 足够存储32位整数
     itoa(value, buffer, 10);
-    sendMessage(topic, buffer);
+    enqueueMessage(topic, buffer);
     return true;
 }
 
@@ -72,7 +593,7 @@ bool SerialPubSub::publish(const char *topic, float value, int decimals)
     }
     char buffer[16];
     dtostrf(value, 0, decimals, buffer);
-    sendMessage(topic, buffer);
+    enqueueMessage(topic, buffer);
     return true;
 }
 
@@ -82,26 +603,123 @@ bool SerialPubSub::publish(const char *topic, bool value)
     {
         return false;
     }
-    sendMessage(topic, value ? "true" : "false");
+    enqueueMessage(topic, value ? "true" : "false");
     return true;
 }
 
-void SerialPubSub::loop()
+// PROGMEM主题重载：主题复制到栈上短缓冲后走普通发布路径，
+// 队列/去重/优先级逻辑不感知来源差异
+bool SerialPubSub::publish(const __FlashStringHelper *topic, const char *payload)
+{
+    char topicBuf[MAX_TOPIC_LENGTH];
+    if (!copyFlashTopic(topic, topicBuf))
+    {
+        return false;
+    }
+    enqueueMessage(topicBuf, payload);
+    return true;
+}
+
+bool SerialPubSub::publish(const __FlashStringHelper *topic, int value)
+{
+    char buffer[12];
+    itoa(value, buffer, 10);
+    return publish(topic, buffer);
+}
+
+bool SerialPubSub::publish(const __FlashStringHelper *topic, float value, int decimals)
+{
+    char buffer[16];
+    dtostrf(value, 0, decimals, buffer);
+    return publish(topic, buffer);
+}
+
+bool SerialPubSub::publish(const __FlashStringHelper *topic, bool value)
+{
+    return publish(topic, value ? "true" : "false");
+}
+
+// 主题与负载都在flash的重载，用于固定状态和错误文案
+// 栈上缓冲容纳最长的错误文案；超过队列槽位上限的负载
+// 会经由enqueueMessage的直发回退路径完整发出
+bool SerialPubSub::publish(const __FlashStringHelper *topic, const __FlashStringHelper *payload)
 {
-    // 调试输出已禁用以避免干扰通信
-    // if (Serial.available() > 0)
-    // {
-    //     Serial.print("Avail:");
-    //     Serial.println(Serial.available());
-    // }
+    if (payload == nullptr)
+    {
+        return publish(topic, "");
+    }
 
+    char payloadBuf[64];
+    strncpy_P(payloadBuf, reinterpret_cast<PGM_P>(payload), sizeof(payloadBuf) - 1);
+    payloadBuf[sizeof(payloadBuf) - 1] = '\0';
+    return publish(topic, payloadBuf);
+}
+
+// 尽早把硬件串口缓冲区（仅64字节）搬入软件环形缓冲区
+// 主机在115200波特率下突发多条命令时不再丢字节
+void SerialPubSub::fillRxRing()
+{
     while (Serial.available() > 0)
     {
-        char c = Serial.read();
+        uint8_t next = (_rxHead + 1) & RX_RING_MASK;
+        if (next == _rxTail)
+        {
+            // 环形缓冲区已满，丢弃并计数
+            Serial.read();
+            _rxOverflowCount++;
+            continue;
+        }
+        _rxRing[_rxHead] = (uint8_t)Serial.read();
+        _rxHead = next;
+    }
+}
+
+// 按节流周期发布溢出诊断计数
+void SerialPubSub::publishDiagnostics()
+{
+    if (_rxOverflowCount == _lastPublishedRxOverflow &&
+        _lineOverflowCount == _lastPublishedLineOverflow &&
+        _txBufferFullCount == _lastPublishedTxBufferFull &&
+        _txDropCount == _lastPublishedTxDrop)
+    {
+        return;
+    }
+
+    unsigned long now = millis();
+    if (now - _lastDiagnosticsTime < 1000)
+    {
+        return;
+    }
+    _lastDiagnosticsTime = now;
+    _lastPublishedRxOverflow = _rxOverflowCount;
+    _lastPublishedLineOverflow = _lineOverflowCount;
+    _lastPublishedTxBufferFull = _txBufferFullCount;
+    _lastPublishedTxDrop = _txDropCount;
+
+    char payload[80];
+    snprintf_P(payload, sizeof(payload),
+               PSTR("rx_overflow:%u,line_overflow:%u,tx_full:%u,tx_drop:%u"),
+               _rxOverflowCount, _lineOverflowCount,
+               _txBufferFullCount, _txDropCount);
+    publish(F("system/diagnostics"), payload);
+}
+
+void SerialPubSub::loop()
+{
+    // 第零步：续写上一轮没发完的字节（硬件TX缓冲此时多半已腾空）
+    flushTxPending();
+
+    // 第一步：搬空硬件缓冲区
+    fillRxRing();
+
+    // 第二步：从环形缓冲区解析消息
+    while (_rxTail != _rxHead)
+    {
+        char c = (char)_rxRing[_rxTail];
+        _rxTail = (_rxTail + 1) & RX_RING_MASK;
 
-        // 调试：显示接收到的字符（十六进制）
-        // Serial.print("Byte:");
-        // Serial.println((int)c, HEX);
+        // 每消费一个字节都再次检查硬件缓冲区，避免解析期间新到字节堆积
+        fillRxRing();
 
         // 检查消息边界（换行符）
         if (c == '\n' || c == '\r')
@@ -115,8 +733,11 @@ void SerialPubSub::loop()
                 // Serial.print("RX:");
                 // Serial.println(receiveBuffer);
 
-                // 解析消息
-                parseMessage(receiveBuffer);
+                // 解析消息（可靠模式下先校验CRC和序号）
+                if (!_reliableMode || verifyReliableLine(receiveBuffer))
+                {
+                    parseMessage(receiveBuffer);
+                }
                 // 重置缓冲区
                 bufferIndex = 0;
             }
@@ -130,12 +751,18 @@ void SerialPubSub::loop()
             }
             else
             {
-                // 缓冲区溢出，丢弃整个消息
-                // Serial.println("BUF_OVERFLOW");
+                // 单条消息超长，丢弃整个消息并计数
+                _lineOverflowCount++;
                 bufferIndex = 0;
             }
         }
     }
+
+    // 第三步：必要时发布诊断计数
+    publishDiagnostics();
+
+    // 第四步：合并下发排队的消息
+    drainTxQueue();
 }
 
 void SerialPubSub::parseMessage(const char *message)
@@ -166,29 +793,49 @@ void SerialPubSub::parseMessage(const char *message)
     // Serial.println(payload);
 
     // 查找匹配的订阅并调用回调
-    int matchCount = 0;
+    // 精确订阅先比较16位哈希，只有哈希命中才做strcmp防碰撞；
+    // 通配订阅("motor/*")只做前缀比较，一个槽位覆盖整个子树
+    uint16_t hash = topicHash16(topic);
     for (int i = 0; i < MAX_SUBSCRIPTIONS; i++)
     {
-        if (subscriptions[i].active && strcmp(subscriptions[i].topic, topic) == 0)
+        if (!subscriptions[i].active || subscriptions[i].callback == nullptr)
         {
-            matchCount++;
-            if (subscriptions[i].callback != nullptr)
-            {
-                subscriptions[i].callback(topic, payload);
-            }
+            continue;
+        }
+
+        bool matched;
+        if (subscriptions[i].prefixLen > 0)
+        {
+            matched = subscriptions[i].inFlash
+                          ? (strncmp_P(topic, subscriptions[i].topic,
+                                       subscriptions[i].prefixLen) == 0)
+                          : (strncmp(subscriptions[i].topic, topic,
+                                     subscriptions[i].prefixLen) == 0);
+        }
+        else
+        {
+            matched = (subscriptions[i].hash == hash &&
+                       (subscriptions[i].inFlash
+                            ? strcmp_P(topic, subscriptions[i].topic) == 0
+                            : strcmp(subscriptions[i].topic, topic) == 0));
         }
-    }
 
-    // 调试：显示匹配数量
-    // Serial.print("Match:");
-    // Serial.println(matchCount);
+        if (matched)
+        {
+            subscriptions[i].callback(topic, payload);
+        }
+    }
 }
 
 int SerialPubSub::findSubscription(const char *topic)
 {
+    uint16_t hash = topicHash16(topic);
     for (int i = 0; i < MAX_SUBSCRIPTIONS; i++)
     {
-        if (subscriptions[i].active && strcmp(subscriptions[i].topic, topic) == 0)
+        if (subscriptions[i].active && subscriptions[i].hash == hash &&
+            (subscriptions[i].inFlash
+                 ? strcmp_P(topic, subscriptions[i].topic) == 0
+                 : strcmp(subscriptions[i].topic, topic) == 0))
         {
             return i;
         }
@@ -210,16 +857,51 @@ int SerialPubSub::findFreeSlot()
 
 bool SerialPubSub::subscribe(const char *topic, MessageCallback callback)
 {
-    if (topic == nullptr || topic[0] == '\0' || callback == nullptr)
+    if (topic == nullptr)
     {
         return false;
     }
+    // 订阅表只保存指针不复制，调用方须传生存期覆盖整个运行的字面量
+    return subscribeSlot(topic, topic, false, callback);
+}
 
-    if (strlen(topic) >= MAX_TOPIC_LENGTH)
+bool SerialPubSub::subscribe(const __FlashStringHelper *topic, MessageCallback callback)
+{
+    // 校验和查重在RAM副本上进行，订阅表里只存flash地址
+    char topicBuf[MAX_TOPIC_LENGTH];
+    if (!copyFlashTopic(topic, topicBuf))
+    {
+        return false;
+    }
+    return subscribeSlot(topicBuf, (const char *)topic, true, callback);
+}
+
+bool SerialPubSub::subscribeSlot(const char *topic, const char *storedTopic,
+                                 bool inFlash, MessageCallback callback)
+{
+    if (topic[0] == '\0' || callback == nullptr)
+    {
+        return false;
+    }
+
+    size_t topicLen = strlen(topic);
+    if (topicLen >= MAX_TOPIC_LENGTH)
     {
         return false;
     }
 
+    // 通配订阅：仅支持末尾的"/*"，匹配该前缀下的全部主题
+    // 模块可用一个槽位("motor/*")替代逐个注册，回调内按后缀分支
+    uint8_t prefixLen = 0;
+    if (strchr(topic, '*') != nullptr)
+    {
+        if (topicLen < 3 || topic[topicLen - 1] != '*' || topic[topicLen - 2] != '/')
+        {
+            return false; // '*'只允许作为"prefix/*"的结尾
+        }
+        prefixLen = (uint8_t)(topicLen - 1); // 前缀含'/'，如"motor/"
+    }
+
     int existingIndex = findSubscription(topic);
     if (existingIndex >= 0)
     {
@@ -233,13 +915,35 @@ bool SerialPubSub::subscribe(const char *topic, MessageCallback callback)
         return false;
     }
 
-    strcpy(subscriptions[freeSlot].topic, topic);
+    subscriptions[freeSlot].topic = storedTopic;
+    subscriptions[freeSlot].inFlash = inFlash;
+    subscriptions[freeSlot].hash = topicHash16(topic);
+    subscriptions[freeSlot].prefixLen = prefixLen;
     subscriptions[freeSlot].callback = callback;
     subscriptions[freeSlot].active = true;
 
     return true;
 }
 
+// 把flash中的主题复制到RAM缓冲，为空或超长返回false
+bool SerialPubSub::copyFlashTopic(const __FlashStringHelper *topic, char *buffer)
+{
+    if (topic == nullptr)
+    {
+        return false;
+    }
+
+    PGM_P src = reinterpret_cast<PGM_P>(topic);
+    size_t len = strnlen_P(src, MAX_TOPIC_LENGTH);
+    if (len == 0 || len >= MAX_TOPIC_LENGTH)
+    {
+        return false;
+    }
+
+    memcpy_P(buffer, src, len + 1);
+    return true;
+}
+
 bool SerialPubSub::unsubscribe(const char *topic)
 {
     if (topic == nullptr || topic[0] == '\0')
@@ -256,8 +960,167 @@ bool SerialPubSub::unsubscribe(const char *topic)
 
     // 清除订阅
     subscriptions[index].active = false;
-    subscriptions[index].topic[0] = '\0';
+    subscriptions[index].topic = nullptr;
+    subscriptions[index].prefixLen = 0;
+    subscriptions[index].inFlash = false;
     subscriptions[index].callback = nullptr;
 
     return true;
 }
+
+bool SerialPubSub::unsubscribe(const __FlashStringHelper *topic)
+{
+    char topicBuf[MAX_TOPIC_LENGTH];
+    if (!copyFlashTopic(topic, topicBuf))
+    {
+        return false;
+    }
+    return unsubscribe(topicBuf);
+}
+
+// 16位FNV-1a主题哈希（注册表只存哈希，不复制主题字符串以节省SRAM）
+uint16_t SerialPubSub::topicHash16(const char *topic)
+{
+    uint32_t hash = 2166136261UL;
+    for (int i = 0; topic[i] != '\0'; i++)
+    {
+        hash ^= (uint8_t)topic[i];
+        hash *= 16777619UL;
+    }
+    return (uint16_t)(hash ^ (hash >> 16));
+}
+
+// CRC8校验（多项式0x07，覆盖类型到负载）
+uint8_t SerialPubSub::crc8(const uint8_t *data, uint8_t length)
+{
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            if (crc & 0x80)
+            {
+                crc = (crc << 1) ^ 0x07;
+            }
+            else
+            {
+                crc <<= 1;
+            }
+        }
+    }
+    return crc;
+}
+
+// 查找已注册的主题ID
+int SerialPubSub::findBinaryTopic(uint16_t hash)
+{
+    for (int i = 0; i < _binaryTopicCount; i++)
+    {
+        if (_binaryTopicHash[i] == hash)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 发送一条二进制帧
+void SerialPubSub::sendBinaryFrame(uint8_t type, uint8_t topicId, const uint8_t *payload, uint8_t length)
+{
+    uint8_t crc = 0;
+
+    // 负载上限与消息上限一致（也保证整帧放得进发送暂存缓冲）
+    if (length > MAX_MESSAGE_LENGTH - 1)
+    {
+        length = MAX_MESSAGE_LENGTH - 1;
+    }
+
+    // CRC覆盖类型、主题ID、长度和负载
+    uint8_t header[3] = {type, topicId, length};
+    crc = crc8(header, 3);
+    if (length > 0)
+    {
+        // 将负载并入CRC（逐段计算避免复制缓冲区）
+        for (uint8_t i = 0; i < length; i++)
+        {
+            uint8_t b = payload[i];
+            crc ^= b;
+            for (uint8_t bit = 0; bit < 8; bit++)
+            {
+                if (crc & 0x80)
+                {
+                    crc = (crc << 1) ^ 0x07;
+                }
+                else
+                {
+                    crc <<= 1;
+                }
+            }
+        }
+    }
+
+    // 整帧组装后一次性非阻塞写出，帧不会被暂存丢弃逻辑截半
+    uint8_t frame[5 + MAX_MESSAGE_LENGTH];
+    uint16_t frameLen = 0;
+    frame[frameLen++] = BINARY_FRAME_SOF;
+    frame[frameLen++] = header[0];
+    frame[frameLen++] = header[1];
+    frame[frameLen++] = header[2];
+    if (length > 0)
+    {
+        memcpy(frame + frameLen, payload, length);
+        frameLen += length;
+    }
+    frame[frameLen++] = crc;
+    writeWire(frame, frameLen);
+}
+
+// 以二进制帧发送消息；首次遇到的主题先发注册帧（ID + 主题字符串）
+void SerialPubSub::sendBinaryMessage(const char *topic, const char *payload)
+{
+    uint16_t hash = topicHash16(topic);
+    int topicId = findBinaryTopic(hash);
+
+    if (topicId < 0)
+    {
+        // 注册表已满时回退为文本协议发送，主机两种格式都能解析
+        if (_binaryTopicCount >= MAX_BINARY_TOPICS)
+        {
+            char line[MAX_TOPIC_LENGTH + MAX_MESSAGE_LENGTH + 2];
+            int len = snprintf_P(line, sizeof(line), PSTR("%s:%s\n"),
+                                 topic, (payload != nullptr) ? payload : "");
+            if (len > 0)
+            {
+                if (len >= (int)sizeof(line))
+                {
+                    len = sizeof(line) - 1;
+                }
+                writeWire((const uint8_t *)line, (uint16_t)len);
+            }
+            return;
+        }
+
+        topicId = _binaryTopicCount;
+        _binaryTopicHash[topicId] = hash;
+        _binaryTopicCount++;
+
+        // 注册帧负载为主题字符串，让主机建立ID到主题的映射
+        sendBinaryFrame(BINARY_FRAME_TOPIC, (uint8_t)topicId,
+                        (const uint8_t *)topic, (uint8_t)strlen(topic));
+    }
+
+    uint8_t payloadLen = 0;
+    if (payload != nullptr)
+    {
+        size_t len = strlen(payload);
+        if (len > 255)
+        {
+            len = 255;
+        }
+        payloadLen = (uint8_t)len;
+    }
+
+    sendBinaryFrame(BINARY_FRAME_DATA, (uint8_t)topicId,
+                    (const uint8_t *)payload, payloadLen);
+}
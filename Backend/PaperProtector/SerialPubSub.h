@@ -4,17 +4,91 @@
 #include <Arduino.h>
 
 // 最大订阅数量
-#define MAX_SUBSCRIPTIONS 16
+// 当前固件注册17个（begin 3 + 聚合状态 1 + 各模块 13），
+// 余量5个正好覆盖AS7341重新启用时MoistureSensor::begin注册的
+// 5个主题（irled/control、irled/get、moisture/measure、
+// moisture/calibrate、moisture/config）；满表时subscribe()返回
+// false，新增模块须同步核对此数
+#define MAX_SUBSCRIPTIONS 22
 // 最大主题长度
 #define MAX_TOPIC_LENGTH 24
-// 最大消息长度
-#define MAX_MESSAGE_LENGTH 64
+// 最大消息长度（moisture/config等JSON消息可超过64字节）
+#define MAX_MESSAGE_LENGTH 128
+
+// 软件接收环形缓冲区大小（必须为2的幂）
+// 在loop()中尽早把硬件串口的64字节缓冲腾空，
+// 避免高波特率下主机突发多条命令时丢字节；
+// 64字节软件缓冲+64字节硬件缓冲足够容纳一轮突发命令
+#define RX_RING_SIZE 64
+#define RX_RING_MASK (RX_RING_SIZE - 1)
+
+// 发送队列：publish()先入队，由loop()合并下发
+// 同一主题的排队消息会被较新的负载覆盖（去重），
+// 周期遥测积压时只有最新值上线。
+// 槽位数和负载上限按2KB SRAM预算压缩：周期遥测负载都在
+// 36字节以内，更长的负载绕过队列直接发送
+#define TX_QUEUE_SIZE 4
+#define TX_QUEUE_PAYLOAD 36 // 超过此长度的负载绕过队列直接发送
+
+// 发送优先级：命令应答/错误 > 状态变化 > 周期遥测
+// 低优先级类受令牌桶限速，遥测洪峰不会推迟交互应答
+enum TxPriority
+{
+    TX_PRIORITY_HIGH = 0,   // 错误和命令应答
+    TX_PRIORITY_NORMAL = 1, // 状态变化
+    TX_PRIORITY_LOW = 2     // 周期遥测
+};
+#define TX_PRIORITY_CLASSES 3
+
+// 发送槽位状态：可靠模式下已发出的槽位转为保留态，
+// 兼作重传窗口副本，不再另设一份重传缓冲
+enum TxSlotState
+{
+    TX_SLOT_FREE = 0,     // 空闲
+    TX_SLOT_QUEUED = 1,   // 排队待发
+    TX_SLOT_RETAINED = 2  // 已发出，保留供可靠模式重传
+};
+
+struct TxMessage
+{
+    char topic[MAX_TOPIC_LENGTH];
+    char payload[TX_QUEUE_PAYLOAD];
+    uint16_t hash;    // 主题哈希，用于去重查找
+    uint16_t seq;     // 入队序号，同优先级内保持FIFO
+    uint8_t priority; // TxPriority
+    uint8_t rseq;     // 可靠模式发送序号（仅RETAINED态有效）
+    uint8_t state;    // TxSlotState
+};
+
+// 二进制帧模式
+// 帧格式: SOF | 类型 | 主题ID | 长度 | 负载 | CRC8
+// CRC8覆盖类型到负载的所有字节
+#define MAX_BINARY_TOPICS 16
+#define BINARY_FRAME_SOF 0xAA
+#define BINARY_FRAME_DATA 0x01  // 数据帧：主题ID + 负载
+#define BINARY_FRAME_TOPIC 0x02 // 注册帧：主题ID + 主题字符串
+
+// 发送暂存缓冲：硬件TX缓冲（64字节）写满时行的剩余部分暂存于此，
+// 由loop()在硬件缓冲腾出空间后续写，sendMessage不再阻塞等待
+// 容量为一条最长行，积压的多条短行可压实共存
+#define TX_PENDING_SIZE (MAX_TOPIC_LENGTH + MAX_MESSAGE_LENGTH + 10)
+
+// 可靠传输模式（可选，主机发送"system/reliable:on"启用）
+// 文本行追加"~<序号>~<CRC8十六进制>"后缀，CRC覆盖主题到序号；
+// 接收方在校验失败或序号出现缺口时用system/nak请求重传。
+// 重传窗口没有独立缓冲：经队列下发的行在原槽位转为RETAINED态
+// 保留最近几个序号，绕过队列的直发行不保留（被NAK时主机
+// 回退到超时重发），省下一份窗口副本的SRAM
+#define RELIABLE_WINDOW_SIZE 3
 
 typedef void (*MessageCallback)(const char *topic, const char *payload);
 
 struct Subscription
 {
-    char topic[MAX_TOPIC_LENGTH];
+    const char *topic; // 主题指针：RAM字面量或PROGMEM地址（不再复制到24字节缓冲）
+    uint16_t hash;     // 主题的FNV-1a哈希，分发时先比哈希再比字符串
+    uint8_t prefixLen; // 通配订阅("motor/*")的前缀长度，0表示精确匹配
+    bool inFlash;      // topic指向flash时为true，比较须走pgm_*系列
     MessageCallback callback;
     bool active;
 };
@@ -24,31 +98,143 @@ class SerialPubSub
 public:
     SerialPubSub();
 
-    void begin(long baudRate = 9600);
+    void begin(long baudRate = 115200);
 
     bool publish(const char *topic, const char *payload);
     bool publish(const char *topic, int value);
     bool publish(const char *topic, float value, int decimals = 2);
     bool publish(const char *topic, bool value);
 
+    // PROGMEM主题重载：配合F()把主题字面量留在flash，不占SRAM
+    bool publish(const __FlashStringHelper *topic, const char *payload);
+    bool publish(const __FlashStringHelper *topic, int value);
+    bool publish(const __FlashStringHelper *topic, float value, int decimals = 2);
+    bool publish(const __FlashStringHelper *topic, bool value);
+    bool publish(const __FlashStringHelper *topic, const __FlashStringHelper *payload);
+
+    // RAM版要求topic在整个运行期有效（传字符串字面量即可）
     bool subscribe(const char *topic, MessageCallback callback);
+    bool subscribe(const __FlashStringHelper *topic, MessageCallback callback);
 
     bool unsubscribe(const char *topic);
+    bool unsubscribe(const __FlashStringHelper *topic);
 
     void loop();
 
+    // 二进制帧模式开关（仅影响发送方向，接收仍为文本协议）
+    void setBinaryMode(bool enabled);
+    bool binaryMode() const;
+
+    // 发送暂存缓冲是否已腾空
+    // 流式大块发送（如历史回传）以此为节流依据：上一块
+    // 还在暂存缓冲里时先不产出下一块，避免触发整行丢弃
+    bool txPendingEmpty() const
+    {
+        return _txPendingLen == _txPendingOffset;
+    }
+
+#ifdef PP_BENCH
+    // 基准固件专用：直接驱动解析路径，绕过串口接收
+    void benchParseMessage(const char *message)
+    {
+        parseMessage(message);
+    }
+#endif
+
 private:
     Subscription subscriptions[MAX_SUBSCRIPTIONS];
     char receiveBuffer[MAX_MESSAGE_LENGTH];
     int bufferIndex;
 
+    // 软件接收环形缓冲区
+    uint8_t _rxRing[RX_RING_SIZE];
+    uint8_t _rxHead; // 写入位置
+    uint8_t _rxTail; // 读取位置
+
+    // 发送队列（槽位池，按优先级+序号选取下发）
+    TxMessage _txQueue[TX_QUEUE_SIZE];
+    uint8_t _txCount;      // 排队中的消息数
+    uint16_t _txSeqCounter; // 入队序号发生器
+
+    // 各优先级类的令牌桶（高优先级不限速）
+    uint8_t _txTokens[TX_PRIORITY_CLASSES];
+    unsigned long _lastTokenRefill;
+
+    // 发送暂存缓冲（线性缓冲，offset之前为已写出部分）
+    uint8_t _txPending[TX_PENDING_SIZE];
+    uint16_t _txPendingLen;    // 暂存的总字节数
+    uint16_t _txPendingOffset; // 已写出的字节数
+
+    // 诊断计数器
+    unsigned int _rxOverflowCount;   // 环形缓冲区满导致的丢字节次数
+    unsigned int _lineOverflowCount; // 单条消息超长导致的丢弃次数
+    unsigned int _txBufferFullCount; // 硬件TX缓冲写满导致的续写次数
+    unsigned int _txDropCount;       // 暂存缓冲也满导致的整行丢弃次数
+    unsigned int _lastPublishedRxOverflow;
+    unsigned int _lastPublishedLineOverflow;
+    unsigned int _lastPublishedTxBufferFull;
+    unsigned int _lastPublishedTxDrop;
+    unsigned long _lastDiagnosticsTime;
+
+    // 二进制模式状态
+    bool _binaryMode;
+    uint16_t _binaryTopicHash[MAX_BINARY_TOPICS]; // 已注册主题的16位哈希
+    uint8_t _binaryTopicCount;
+
+    // 可靠传输模式状态（重传副本存放在_txQueue的RETAINED槽位）
+    bool _reliableMode;
+    uint8_t _txReliableSeq;  // 下一个发送序号
+    uint8_t _rxExpectedSeq;  // 期望收到的下一个序号
+    bool _rxSeqSynced;       // 是否已与主机序号同步
+
+    static void binaryModeCallback(const char *topic, const char *payload);
+    static void reliableModeCallback(const char *topic, const char *payload);
+    static void nakCallback(const char *topic, const char *payload);
+    static SerialPubSub *_instance;
+
     void parseMessage(const char *message);
 
+    void fillRxRing();
+    void publishDiagnostics();
+
+    void enqueueMessage(const char *topic, const char *payload);
+    void drainTxQueue();
+    void refillTxTokens();
+    static uint8_t classifyTopic(const char *topic);
+
     int findSubscription(const char *topic);
 
     int findFreeSlot();
 
+    // 订阅表公共写入路径：topic为RAM中的校验用文本，
+    // storedTopic为真正写入槽位的指针（RAM字面量或flash地址）
+    bool subscribeSlot(const char *topic, const char *storedTopic,
+                       bool inFlash, MessageCallback callback);
+
+    // 把flash主题复制到MAX_TOPIC_LENGTH的RAM缓冲，超长或为空返回false
+    static bool copyFlashTopic(const __FlashStringHelper *topic, char *buffer);
+
     void sendMessage(const char *topic, const char *payload);
+
+    // flash主题的直发重载：复制到栈缓冲后走sendMessage
+    void sendMessage(const __FlashStringHelper *topic, const char *payload);
+
+    // 非阻塞写出：先写硬件缓冲能容纳的部分，剩余暂存续写
+    void writeWire(const uint8_t *data, uint16_t length);
+    void flushTxPending();
+
+    // 可靠传输内部方法
+    void sendReliableLine(const char *topic, const char *payload, uint8_t seq);
+    bool verifyReliableLine(char *message);
+    void handleNak(const char *payload);
+    void clearRetainedSlots();
+
+    // 二进制帧内部方法
+    void sendBinaryMessage(const char *topic, const char *payload);
+    void sendBinaryFrame(uint8_t type, uint8_t topicId, const uint8_t *payload, uint8_t length);
+    int findBinaryTopic(uint16_t hash);
+    static uint16_t topicHash16(const char *topic);
+    static uint8_t crc8(const uint8_t *data, uint8_t length);
 };
 
 #endif
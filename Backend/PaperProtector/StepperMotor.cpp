@@ -11,10 +11,58 @@ StepperMotor::StepperMotor(SerialPubSub *pubsub, int dirPin, int stepPin)
       _stepsPerRevolution(200), // 默认200步/圈 (1.8度步进角)
       _stepDelayMicros(1000),   // 默认1000微秒延迟
       _isBusy(false),
-      _currentSteps(0),       // 初始位置为0
-      _mmPerRevolution(1.498) // 实测每圈1.498mm (134.8mm / 90圈)
+      _currentSteps(0),        // 初始位置为0
+      _mmPerRevolution(1.498), // 实测每圈1.498mm (134.8mm / 90圈)
+      _motionState(MOTION_IDLE),
+      _stepsRemaining(0),
+      _stepDirection(1),
+      _lastPhaseMicros(0),
+      _queueHead(0),
+      _queueTail(0),
+      _queueCount(0),
+      _plannedSteps(0),
+      _rampSteps(0), // 默认禁用加减速（与旧版行为一致）
+      _totalSteps(0),
+      _stepIndex(0),
+      _rampLen(0),
+      _phaseDelayMicros(1000),
+      _progressIntervalMs(250), // 默认250ms一次在途位置
+      _lastProgressMs(0)
 {
     _instance = this;
+    _umPerStepFx = 0;
+    computePositionScale();
+    computeRampTable();
+}
+
+// 由机械参数导出每步微米数（Q16.16定点）
+// 浮点只在这一次配置换算中出现，位置相关的热路径全为整数
+void StepperMotor::computePositionScale()
+{
+    if (_stepsPerRevolution <= 0)
+    {
+        _umPerStepFx = 0;
+        return;
+    }
+    _umPerStepFx = (uint32_t)((_mmPerRevolution * 1000.0 * 65536.0) /
+                                  _stepsPerRevolution +
+                              0.5);
+}
+
+// 步数→微米（64位中间量防溢出，行程内的微米值轻松容于32位）
+long StepperMotor::stepsToUm(long steps) const
+{
+    return (long)(((int64_t)steps * (int64_t)_umPerStepFx) / 65536);
+}
+
+// 微米→步数（向零截断，与stepsToUm对称）
+long StepperMotor::umToSteps(long um) const
+{
+    if (_umPerStepFx == 0)
+    {
+        return 0;
+    }
+    return (long)(((int64_t)um * 65536) / (int64_t)_umPerStepFx);
 }
 
 // 初始化方法 - 配置引脚和订阅主题
@@ -24,37 +72,176 @@ void StepperMotor::begin()
     pinMode(_dirPin, OUTPUT);
     pinMode(_stepPin, OUTPUT);
 
+#ifdef __AVR__
+    // 一次性解析引脚到端口寄存器和位掩码，供快速GPIO路径使用
+    _stepPort = portOutputRegister(digitalPinToPort(_stepPin));
+    _stepBitMask = digitalPinToBitMask(_stepPin);
+    _dirPort = portOutputRegister(digitalPinToPort(_dirPin));
+    _dirBitMask = digitalPinToBitMask(_dirPin);
+#endif
+
     // 设置初始状态
-    digitalWrite(_dirPin, LOW);
-    digitalWrite(_stepPin, LOW);
+    writeDirPin(LOW);
+    writeStepPin(LOW);
 
-    // 订阅motor/rotate主题
-    _pubsub->subscribe("motor/rotate", messageCallback);
+    // 通配订阅motor子树，单个槽位覆盖全部命令主题，
+    // 具体命令在dispatchCallback中按后缀分发
+    _pubsub->subscribe(F("motor/*"), dispatchCallback);
+
+    // 发布初始配置和位置
+    publishConfig();
+    publishPosition();
+}
+
+// 循环处理方法 - 驱动非阻塞运动状态机
+// 每次调用最多切换一次STEP引脚电平，主循环在步进间隔内
+// 可以继续处理串口、传感器和PWM，不再被长距离移动阻塞
+void StepperMotor::loop()
+{
+    if (_motionState == MOTION_IDLE)
+    {
+        return;
+    }
 
-    // 订阅motor/config主题
-    _pubsub->subscribe("motor/config", configCallback);
+    unsigned long now = micros();
 
-    // 订阅motor/calibrate主题（校准/调零）
-    _pubsub->subscribe("motor/calibrate", calibrateCallback);
+    // 未到下一次电平切换时间，直接返回（micros()差值运算对溢出安全）
+    if (now - _lastPhaseMicros < _phaseDelayMicros)
+    {
+        return;
+    }
 
-    // 订阅motor/home主题（回零）
-    _pubsub->subscribe("motor/home", homeCallback);
+    if (_motionState == MOTION_PULSE_LOW)
+    {
+        // 进入新的一步：按梯形曲线查表取本步延迟
+        _phaseDelayMicros = stepIntervalMicros(_stepIndex);
 
-    // 订阅motor/position/get主题（查询位置）
-    _pubsub->subscribe("motor/position/get", positionCallback);
+        // 产生脉冲上升沿
+        writeStepPin(HIGH);
+        _lastPhaseMicros = now;
+        _motionState = MOTION_PULSE_HIGH;
+    }
+    else // MOTION_PULSE_HIGH
+    {
+        // 产生脉冲下降沿，并在此计数一步
+        writeStepPin(LOW);
+        _lastPhaseMicros = now;
+        _motionState = MOTION_PULSE_LOW;
 
-    // 订阅motor/moveto主题（移动到指定mm位置）
-    _pubsub->subscribe("motor/moveto", moveToCallback);
+        _currentSteps += _stepDirection;
+        _stepIndex++;
+        _stepsRemaining--;
 
-    // 发布初始配置和位置
-    publishConfig();
-    publishPosition();
+        if (_stepsRemaining <= 0)
+        {
+            finishMotion();
+        }
+        else if (_progressIntervalMs > 0)
+        {
+            // 在途进度流：长行程期间按配置节奏发布当前位置，
+            // 主机不再面对冻结的位置直到运动结束才跳变。
+            // publish只入TX队列（position为低优先级且同主题去重，
+            // 未发出的旧进度会被新值覆盖），此处不产生串口等待
+            unsigned long nowMs = millis();
+            if (nowMs - _lastProgressMs >= _progressIntervalMs)
+            {
+                _lastProgressMs = nowMs;
+                publishPosition();
+            }
+        }
+    }
 }
 
-// 循环处理方法（当前为空，预留用于非阻塞实现）
-void StepperMotor::loop()
+// 预计算梯形加减速表
+// 采用恒定加速度近似：第i步延迟 = 巡航延迟 * (sqrt(i+1)-sqrt(i)) * sqrt(N)，
+// N为配置的加速段步数：首项约为巡航延迟的sqrt(N)倍，
+// 第N项恰好收敛到巡航延迟，加速段到巡航段之间没有速度跳变。
+// 浮点运算只发生在配置时刻，步进热路径只查表。
+void StepperMotor::computeRampTable()
 {
-    // 预留用于未来的非阻塞实现
+    if (_rampSteps <= 0)
+    {
+        return; // 加减速禁用时不查表（_rampLen恒为0）
+    }
+
+    float cruise = (float)_stepDelayMicros;
+    float c0 = cruise * sqrt((float)_rampSteps);
+
+    for (int i = 0; i < _rampSteps; i++)
+    {
+        float interval = c0 * (sqrt((float)(i + 1)) - sqrt((float)i));
+
+        // 不低于巡航延迟，且限制在uint16_t范围内
+        if (interval < cruise)
+        {
+            interval = cruise;
+        }
+        if (interval > 65535.0)
+        {
+            interval = 65535.0;
+        }
+        _rampTable[i] = (uint16_t)interval;
+    }
+}
+
+// 计算第stepIndex步的每相位延迟（加速段/巡航段/减速段）
+unsigned long StepperMotor::stepIntervalMicros(long stepIndex)
+{
+    if (_rampLen <= 0)
+    {
+        return _stepDelayMicros;
+    }
+
+    // 加速段：正向查表
+    if (stepIndex < _rampLen)
+    {
+        return _rampTable[stepIndex];
+    }
+
+    // 减速段：镜像查表
+    long remaining = _totalSteps - stepIndex;
+    if (remaining <= _rampLen)
+    {
+        return _rampTable[remaining - 1];
+    }
+
+    // 巡航段
+    return _stepDelayMicros;
+}
+
+// 写STEP引脚（AVR上直接操作PORT寄存器）
+// 所有端口写都发生在主循环上下文，读-改-写无需关中断保护
+void StepperMotor::writeStepPin(uint8_t level)
+{
+#ifdef __AVR__
+    if (level == HIGH)
+    {
+        *_stepPort |= _stepBitMask;
+    }
+    else
+    {
+        *_stepPort &= ~_stepBitMask;
+    }
+#else
+    digitalWrite(_stepPin, level);
+#endif
+}
+
+// 写DIR引脚（AVR上直接操作PORT寄存器）
+void StepperMotor::writeDirPin(uint8_t level)
+{
+#ifdef __AVR__
+    if (level == HIGH)
+    {
+        *_dirPort |= _dirBitMask;
+    }
+    else
+    {
+        *_dirPort &= ~_dirBitMask;
+    }
+#else
+    digitalWrite(_dirPin, level);
+#endif
 }
 
 // 旋转指定圈数
@@ -64,32 +251,54 @@ void StepperMotor::rotate(float revolutions)
 }
 
 // 移动到指定毫米位置
+// 以全部排队段执行完后的预期位置为基准计算增量，
+// 运动期间连续下发的moveto会得到正确的最终位置。
+// 全程在整数微米表示上计算：目标mm只在入口换算一次，
+// 与publishPosition共用同一_umPerStepFx，两者不再有边缘分歧
 void StepperMotor::moveTo(float targetMm)
 {
-    // 计算当前位置（mm）
-    long currentRevolutions_x100 = (_currentSteps * 100L) / _stepsPerRevolution;
-    float currentMm = (float)currentRevolutions_x100 / 100.0 * _mmPerRevolution;
-
-    // 计算需要移动的距离
-    float deltaMm = targetMm - currentMm;
+    long targetUm = (long)(targetMm * 1000.0 + ((targetMm >= 0) ? 0.5 : -0.5));
+    long plannedUm = stepsToUm(_plannedSteps);
+    long stepDelta = umToSteps(targetUm - plannedUm);
 
-    // 转换为圈数
-    float revolutions = deltaMm / _mmPerRevolution;
-
-    // 执行移动
-    executeRotation(revolutions);
+    enqueueMove(stepDelta);
 }
 
-// 设置每圈步数
+// 设置每圈步数（同时重建位置换算系数）
 void StepperMotor::setStepsPerRevolution(int steps)
 {
     _stepsPerRevolution = steps;
+    computePositionScale();
 }
 
-// 设置步进延迟
+// 设置步进延迟（巡航速度），同时重建加减速表
 void StepperMotor::setStepDelay(unsigned long delayMicros)
 {
     _stepDelayMicros = delayMicros;
+    computeRampTable();
+}
+
+// 设置加速段步数（0 = 禁用加减速），同时重建加减速表——
+// 表的曲线由加速段长度决定，只在setStepDelay时重建会让
+// 短加速段的末项停在巡航速度之上，产生加速到巡航的速度跳变
+void StepperMotor::setRampSteps(int steps)
+{
+    if (steps < 0)
+    {
+        steps = 0;
+    }
+    if (steps > STEPPER_RAMP_TABLE_SIZE)
+    {
+        steps = STEPPER_RAMP_TABLE_SIZE;
+    }
+    _rampSteps = steps;
+    computeRampTable();
+}
+
+// 设置运动中进度发布周期（0 = 关闭在途发布）
+void StepperMotor::setProgressInterval(unsigned long intervalMs)
+{
+    _progressIntervalMs = intervalMs;
 }
 
 // 获取忙碌状态
@@ -98,6 +307,38 @@ bool StepperMotor::isBusy() const
     return _isBusy;
 }
 
+// 通配订阅的分发回调：按"motor/"后的后缀路由到具体处理函数
+// 未知后缀静默忽略（可能是主机误发的出站主题名）
+void StepperMotor::dispatchCallback(const char *topic, const char *payload)
+{
+    const char *suffix = topic + 6; // 跳过"motor/"
+
+    if (strcmp(suffix, "rotate") == 0)
+    {
+        messageCallback(topic, payload);
+    }
+    else if (strcmp(suffix, "config") == 0)
+    {
+        configCallback(topic, payload);
+    }
+    else if (strcmp(suffix, "calibrate") == 0)
+    {
+        calibrateCallback(topic, payload);
+    }
+    else if (strcmp(suffix, "home") == 0)
+    {
+        homeCallback(topic, payload);
+    }
+    else if (strcmp(suffix, "position/get") == 0)
+    {
+        positionCallback(topic, payload);
+    }
+    else if (strcmp(suffix, "moveto") == 0)
+    {
+        moveToCallback(topic, payload);
+    }
+}
+
 // 静态消息回调函数
 void StepperMotor::messageCallback(const char *topic, const char *payload)
 {
@@ -106,7 +347,7 @@ void StepperMotor::messageCallback(const char *topic, const char *payload)
         // 检查payload是否为空
         if (payload == nullptr || payload[0] == '\0')
         {
-            _instance->publishError("Invalid number format");
+            _instance->publishError(F("Invalid number format"));
             return;
         }
 
@@ -136,7 +377,7 @@ void StepperMotor::messageCallback(const char *topic, const char *payload)
             else
             {
                 // 遇到无效字符
-                _instance->publishError("Invalid number format");
+                _instance->publishError(F("Invalid number format"));
                 return;
             }
             i++;
@@ -145,84 +386,171 @@ void StepperMotor::messageCallback(const char *topic, const char *payload)
         // 必须至少有一个数字
         if (!hasDigit)
         {
-            _instance->publishError("Invalid number format");
+            _instance->publishError(F("Invalid number format"));
             return;
         }
 
         // 解析payload为浮点数
         float revolutions = atof(payload);
 
-        // 检查电机是否忙碌
-        if (_instance->isBusy())
-        {
-            _instance->publishError("Motor busy");
-            return;
-        }
-
-        // 执行旋转
+        // 执行旋转（电机忙碌时自动进入命令队列）
         _instance->rotate(revolutions);
     }
 }
 
-// 执行旋转操作
+// 旋转请求入口：换算为带符号步数增量后进入命令队列
 void StepperMotor::executeRotation(float revolutions)
 {
-    // 设置忙碌状态
-    _isBusy = true;
+    long stepDelta = (long)(revolutions * _stepsPerRevolution);
+    enqueueMove(stepDelta);
+}
 
-    // 发布rotating状态
-    publishStatus("rotating");
+// 将一段运动放入命令队列
+// 空闲时立即启动；运动期间尝试前瞻合并到当前段或队尾的同方向段，
+// 电机在合并后的段之间不会减速停顿
+void StepperMotor::enqueueMove(long stepDelta)
+{
+    // 零步运动：空闲时仍然回报状态和位置
+    if (stepDelta == 0)
+    {
+        if (!_isBusy)
+        {
+            publishStatus(F("idle"));
+            publishPosition();
+        }
+        return;
+    }
 
-    // 设置方向引脚
-    if (revolutions >= 0)
+    // 空闲且无排队段：直接启动
+    if (!_isBusy && _queueCount == 0)
     {
-        digitalWrite(_dirPin, HIGH); // 正数 = 顺时针
+        _plannedSteps += stepDelta;
+        startMove(stepDelta);
+        return;
     }
-    else
+
+    // 前瞻合并1：与正在执行的段同方向，且尚未进入减速段时直接延长当前段
+    if (_isBusy && _queueCount == 0)
     {
-        digitalWrite(_dirPin, LOW); // 负数 = 逆时针
+        bool sameDirection = (stepDelta > 0) == (_stepDirection > 0);
+        if (sameDirection && _stepIndex < _totalSteps - _rampLen)
+        {
+            long extra = (stepDelta > 0) ? stepDelta : -stepDelta;
+            _totalSteps += extra;
+            _stepsRemaining += extra;
+            _plannedSteps += stepDelta;
+            return;
+        }
     }
 
-    // 计算总步数
-    long totalSteps = (long)(abs(revolutions) * _stepsPerRevolution);
+    // 前瞻合并2：与队尾段同方向时合并为一段
+    if (_queueCount > 0)
+    {
+        uint8_t last = (_queueHead + STEPPER_QUEUE_SIZE - 1) % STEPPER_QUEUE_SIZE;
+        if ((_moveQueue[last] > 0) == (stepDelta > 0))
+        {
+            _moveQueue[last] += stepDelta;
+            _plannedSteps += stepDelta;
+            return;
+        }
+    }
 
-    // 生成步进脉冲
-    for (long i = 0; i < totalSteps; i++)
+    // 入队为新段
+    if (_queueCount >= STEPPER_QUEUE_SIZE)
     {
-        digitalWrite(_stepPin, HIGH);
-        delayMicroseconds(_stepDelayMicros);
-        digitalWrite(_stepPin, LOW);
-        delayMicroseconds(_stepDelayMicros);
+        publishError(F("Queue full"));
+        return;
     }
+    _moveQueue[_queueHead] = stepDelta;
+    _queueHead = (_queueHead + 1) % STEPPER_QUEUE_SIZE;
+    _queueCount++;
+    _plannedSteps += stepDelta;
+}
+
+// 启动一段运动（非阻塞：只配置状态机，脉冲由loop()生成）
+void StepperMotor::startMove(long stepDelta)
+{
+    long totalSteps;
 
-    // 更新当前步数
-    if (revolutions >= 0)
+    // 设置方向引脚和步数符号
+    if (stepDelta >= 0)
     {
-        _currentSteps += totalSteps;
+        writeDirPin(HIGH); // 正数 = 顺时针
+        _stepDirection = 1;
+        totalSteps = stepDelta;
     }
     else
     {
-        _currentSteps -= totalSteps;
+        writeDirPin(LOW); // 负数 = 逆时针
+        _stepDirection = -1;
+        totalSteps = -stepDelta;
+    }
+
+    // 配置梯形曲线：短行程时加速段最多占总步数的一半
+    _totalSteps = totalSteps;
+    _stepIndex = 0;
+    _rampLen = _rampSteps;
+    if (_rampLen > totalSteps / 2)
+    {
+        _rampLen = totalSteps / 2;
+    }
+
+    // 启动状态机
+    _stepsRemaining = totalSteps;
+    _phaseDelayMicros = stepIntervalMicros(0);
+    _lastPhaseMicros = micros();
+    _motionState = MOTION_PULSE_LOW;
+
+    // 发布rotating状态（队列接续执行时不重复发布）
+    if (!_isBusy)
+    {
+        _isBusy = true;
+        // 进度计时从运动开始重新起算，首个在途位置在一个周期后发出
+        _lastProgressMs = millis();
+        publishStatus(F("rotating"));
+    }
+}
+
+// 段执行完成处理（由loop()在最后一步后调用）
+void StepperMotor::finishMotion()
+{
+    _motionState = MOTION_IDLE;
+    _stepsRemaining = 0;
+
+    // 队列中还有排队段：发布中间位置后立即接续执行
+    if (_queueCount > 0)
+    {
+        long next = _moveQueue[_queueTail];
+        _queueTail = (_queueTail + 1) % STEPPER_QUEUE_SIZE;
+        _queueCount--;
+
+        publishPosition();
+        startMove(next);
+        return;
     }
 
-    // 清除忙碌状态
     _isBusy = false;
 
     // 发布完成状态和位置
-    publishStatus("idle");
+    publishStatus(F("idle"));
     publishPosition();
 }
 
 // 发布状态消息
-void StepperMotor::publishStatus(const char *status)
+void StepperMotor::publishStatus(const __FlashStringHelper *status)
 {
-    _pubsub->publish("motor/status", status);
+    _pubsub->publish(F("motor/status"), status);
 }
 
 // 发布错误消息
 void StepperMotor::publishError(const char *error)
 {
-    _pubsub->publish("motor/error", error);
+    _pubsub->publish(F("motor/error"), error);
+}
+
+void StepperMotor::publishError(const __FlashStringHelper *error)
+{
+    _pubsub->publish(F("motor/error"), error);
 }
 
 // 静态配置回调函数
@@ -233,7 +561,7 @@ void StepperMotor::configCallback(const char *topic, const char *payload)
         // 检查payload是否为空
         if (payload == nullptr || payload[0] == '\0')
         {
-            _instance->publishError("Invalid config format");
+            _instance->publishError(F("Invalid config format"));
             return;
         }
 
@@ -244,7 +572,7 @@ void StepperMotor::configCallback(const char *topic, const char *payload)
         const char *separator = strchr(payload, ':');
         if (separator == nullptr)
         {
-            _instance->publishError("Invalid config format");
+            _instance->publishError(F("Invalid config format"));
             return;
         }
 
@@ -253,7 +581,7 @@ void StepperMotor::configCallback(const char *topic, const char *payload)
         char paramName[20];
         if (nameLen >= 20)
         {
-            _instance->publishError("Invalid config format");
+            _instance->publishError(F("Invalid config format"));
             return;
         }
         strncpy(paramName, payload, nameLen);
@@ -263,7 +591,7 @@ void StepperMotor::configCallback(const char *topic, const char *payload)
         const char *valueStr = separator + 1;
         if (valueStr[0] == '\0')
         {
-            _instance->publishError("Invalid config format");
+            _instance->publishError(F("Invalid config format"));
             return;
         }
 
@@ -277,14 +605,14 @@ void StepperMotor::configCallback(const char *topic, const char *payload)
             }
             else
             {
-                _instance->publishError("Invalid config value");
+                _instance->publishError(F("Invalid config value"));
                 return;
             }
         }
 
         if (!hasDigit)
         {
-            _instance->publishError("Invalid config value");
+            _instance->publishError(F("Invalid config value"));
             return;
         }
 
@@ -296,7 +624,7 @@ void StepperMotor::configCallback(const char *topic, const char *payload)
         {
             if (value <= 0 || value > 10000)
             {
-                _instance->publishError("Steps out of range (1-10000)");
+                _instance->publishError(F("Steps out of range (1-10000)"));
                 return;
             }
             _instance->setStepsPerRevolution((int)value);
@@ -306,15 +634,36 @@ void StepperMotor::configCallback(const char *topic, const char *payload)
         {
             if (value < 100 || value > 100000)
             {
-                _instance->publishError("Delay out of range (100-100000 us)");
+                _instance->publishError(F("Delay out of range (100-100000 us)"));
                 return;
             }
             _instance->setStepDelay((unsigned long)value);
             _instance->publishConfig();
         }
+        else if (strcmp(paramName, "ramp") == 0)
+        {
+            if (value > STEPPER_RAMP_TABLE_SIZE)
+            {
+                _instance->publishError(F("Ramp out of range (0-32)"));
+                return;
+            }
+            _instance->setRampSteps((int)value);
+            _instance->publishConfig();
+        }
+        else if (strcmp(paramName, "progress") == 0)
+        {
+            // 0关闭在途发布；下限50ms防止进度流占满低优先级发送配额
+            if (value != 0 && (value < 50 || value > 60000))
+            {
+                _instance->publishError(F("Progress out of range (0 or 50-60000 ms)"));
+                return;
+            }
+            _instance->setProgressInterval((unsigned long)value);
+            _instance->publishConfig();
+        }
         else
         {
-            _instance->publishError("Unknown config parameter");
+            _instance->publishError(F("Unknown config parameter"));
         }
     }
 }
@@ -322,29 +671,37 @@ void StepperMotor::configCallback(const char *topic, const char *payload)
 // 发布当前配置
 void StepperMotor::publishConfig()
 {
-    char configMsg[50];
-    snprintf(configMsg, sizeof(configMsg), "steps:%d,delay:%lu",
-             _stepsPerRevolution, _stepDelayMicros);
-    _pubsub->publish("motor/config/status", configMsg);
+    char configMsg[64];
+    snprintf_P(configMsg, sizeof(configMsg), PSTR("steps:%d,delay:%lu,ramp:%d,progress:%lu"),
+               _stepsPerRevolution, _stepDelayMicros, _rampSteps, _progressIntervalMs);
+    _pubsub->publish(F("motor/config/status"), configMsg);
+}
+
+// 当前位置的圈数（x100整数，保留两位小数精度）
+long StepperMotor::positionRevolutionsX100() const
+{
+    return (_currentSteps * 100L) / _stepsPerRevolution;
+}
+
+// 当前位置的毫米值（x100整数，由定点微米表示换算而来，
+// 与moveTo共用同一_umPerStepFx系数）
+long StepperMotor::positionMmX100() const
+{
+    return stepsToUm(_currentSteps) / 10;
 }
 
 // 发布当前位置
 void StepperMotor::publishPosition()
 {
-    // 计算圈数（保留两位小数）
-    long revolutions_x100 = (_currentSteps * 100L) / _stepsPerRevolution;
-
-    // 使用 _mmPerRevolution 计算位置（与moveTo保持一致）
-    // 将 _mmPerRevolution 转换为 x100 的整数运算以避免浮点数
-    long mmPerRev_x100 = (long)(_mmPerRevolution * 100);
-    long position_mm_x100 = (revolutions_x100 * mmPerRev_x100) / 100L;
+    long revolutions_x100 = positionRevolutionsX100();
+    long position_mm_x100 = positionMmX100();
 
     char posMsg[64];
     // 整数部分,小数部分
-    snprintf(posMsg, sizeof(posMsg), "%ld.%02ld,%ld.%02ld",
-             revolutions_x100 / 100, abs(revolutions_x100 % 100),
-             position_mm_x100 / 100, abs(position_mm_x100 % 100));
-    _pubsub->publish("motor/position", posMsg);
+    snprintf_P(posMsg, sizeof(posMsg), PSTR("%ld.%02ld,%ld.%02ld"),
+               revolutions_x100 / 100, abs(revolutions_x100 % 100),
+               position_mm_x100 / 100, abs(position_mm_x100 % 100));
+    _pubsub->publish(F("motor/position"), posMsg);
 }
 
 // 校准回调（将当前位置设为0）
@@ -354,13 +711,14 @@ void StepperMotor::calibrateCallback(const char *topic, const char *payload)
     {
         if (_instance->_isBusy)
         {
-            _instance->publishError("Motor busy");
+            _instance->publishError(F("Motor busy"));
             return;
         }
 
-        // 将当前位置设为0
+        // 将当前位置设为0（空闲状态下预期位置同步清零）
         _instance->_currentSteps = 0;
-        _instance->publishStatus("calibrated");
+        _instance->_plannedSteps = 0;
+        _instance->publishStatus(F("calibrated"));
         _instance->publishPosition();
     }
 }
@@ -370,18 +728,8 @@ void StepperMotor::homeCallback(const char *topic, const char *payload)
 {
     if (_instance != nullptr)
     {
-        if (_instance->_isBusy)
-        {
-            _instance->publishError("Motor busy");
-            return;
-        }
-
-        // 计算需要移动的圈数（回到0位置）
-        float currentRevolutions = (float)_instance->_currentSteps / _instance->_stepsPerRevolution;
-        float moveRevolutions = -currentRevolutions; // 反向移动
-
-        // 执行回零
-        _instance->rotate(moveRevolutions);
+        // 以预期位置为基准回零，运动期间下发时自动排队
+        _instance->enqueueMove(-_instance->_plannedSteps);
     }
 }
 
@@ -402,7 +750,7 @@ void StepperMotor::moveToCallback(const char *topic, const char *payload)
         // 检查payload是否为空
         if (payload == nullptr || payload[0] == '\0')
         {
-            _instance->publishError("Invalid position");
+            _instance->publishError(F("Invalid position"));
             return;
         }
 
@@ -432,7 +780,7 @@ void StepperMotor::moveToCallback(const char *topic, const char *payload)
             else
             {
                 // 遇到非法字符
-                _instance->publishError("Invalid number");
+                _instance->publishError(F("Invalid number"));
                 return;
             }
             i++;
@@ -441,7 +789,7 @@ void StepperMotor::moveToCallback(const char *topic, const char *payload)
         // 必须至少有一位数字
         if (!hasDigit)
         {
-            _instance->publishError("Invalid number");
+            _instance->publishError(F("Invalid number"));
             return;
         }
 
@@ -4,6 +4,21 @@
 #include <Arduino.h>
 #include "SerialPubSub.h"
 
+// 加减速表最大长度（每项2字节，共64字节SRAM）
+// sqrt曲线下32步加速段已有约5.7倍的首末速度比，够3-4倍步进率用
+#define STEPPER_RAMP_TABLE_SIZE 32
+
+// 运动命令队列长度（每项为带符号步数增量）
+#define STEPPER_QUEUE_SIZE 8
+
+// 运动状态机状态
+enum StepperMotionState
+{
+    MOTION_IDLE,       // 空闲，无待执行的运动
+    MOTION_PULSE_HIGH, // STEP引脚处于高电平阶段
+    MOTION_PULSE_LOW   // STEP引脚处于低电平阶段
+};
+
 class StepperMotor
 {
 public:
@@ -13,7 +28,7 @@ public:
     // 初始化
     void begin();
 
-    // 循环处理（如果需要非阻塞控制）
+    // 循环处理（驱动非阻塞运动状态机）
     void loop();
 
     // 旋转指定圈数（正数=顺时针，负数=逆时针）
@@ -25,14 +40,30 @@ public:
     // 设置步进电机参数
     void setStepsPerRevolution(int steps);
     void setStepDelay(unsigned long delayMicros);
+    void setRampSteps(int steps);
+    void setProgressInterval(unsigned long intervalMs);
 
     // 获取当前状态
     bool isBusy() const;
 
+    // 当前位置（圈数x100 / 毫米x100），与motor/position发布值同源，
+    // 供聚合状态快照等只读场景使用
+    long positionRevolutionsX100() const;
+    long positionMmX100() const;
+
 private:
     SerialPubSub *_pubsub;
     int _dirPin;
     int _stepPin;
+
+#ifdef __AVR__
+    // 快速GPIO：begin()时把引脚解析为端口寄存器+位掩码，
+    // 步进热路径直接写PORTx，省掉digitalWrite每次~5µs的查表开销
+    volatile uint8_t *_stepPort;
+    uint8_t _stepBitMask;
+    volatile uint8_t *_dirPort;
+    uint8_t _dirBitMask;
+#endif
     int _stepsPerRevolution;
     unsigned long _stepDelayMicros;
     bool _isBusy;
@@ -41,7 +72,46 @@ private:
     long _currentSteps;     // 当前步数（可正可负）
     float _mmPerRevolution; // 每圈移动的毫米数
 
+    // 定点位置内核：每步微米数（Q16.16），配置时由
+    // _mmPerRevolution/_stepsPerRevolution一次性导出。
+    // moveTo/publishPosition/回零全部经由同一整数微米表示换算，
+    // 运动路径不再碰浮点，也消除了浮点与x100两套近似的边缘分歧
+    uint32_t _umPerStepFx;
+
+    // 非阻塞运动状态机
+    StepperMotionState _motionState; // 当前状态机状态
+    long _stepsRemaining;            // 本次运动剩余步数
+    int _stepDirection;              // 步进方向（+1 或 -1）
+    unsigned long _lastPhaseMicros;  // 上一次电平切换的时间戳（micros）
+
+    // 运动命令队列
+    // 电机运动期间到达的rotate/moveto命令入队排队执行；
+    // 同方向的相邻段会被合并，电机在段间不减速
+    long _moveQueue[STEPPER_QUEUE_SIZE]; // 排队的带符号步数增量
+    uint8_t _queueHead;                  // 下一个写入槽位
+    uint8_t _queueTail;                  // 下一个执行槽位
+    uint8_t _queueCount;                 // 排队中的段数
+    long _plannedSteps;                  // 全部排队段执行完后的预期位置
+
+    // 梯形加减速
+    // 表项为每相位延迟（微秒），在配置变更时用浮点预计算一次，
+    // 步进过程中只做整数查表，避免在16MHz AVR上每步算浮点
+    uint16_t _rampTable[STEPPER_RAMP_TABLE_SIZE];
+    int _rampSteps;                 // 加速段步数（0 = 禁用加减速）
+    long _totalSteps;               // 本次运动总步数
+    long _stepIndex;                // 本次运动已完成步数
+    long _rampLen;                  // 本次运动实际使用的加速段长度
+    unsigned long _phaseDelayMicros; // 当前步的每相位延迟
+
+    // 运动中进度流
+    // 长行程期间按该周期在motor/position发布在途位置（0 = 关闭，
+    // 保持只在段结束时发布的旧行为）。发布只入TX队列，position
+    // 主题按去重覆盖为最新值，步进热路径上不等待串口
+    unsigned long _progressIntervalMs; // 进度发布周期(毫秒)
+    unsigned long _lastProgressMs;     // 上次在途发布时刻
+
     // 消息回调处理
+    static void dispatchCallback(const char *topic, const char *payload);
     static void messageCallback(const char *topic, const char *payload);
     static void configCallback(const char *topic, const char *payload);
     static void calibrateCallback(const char *topic, const char *payload);
@@ -51,9 +121,20 @@ private:
     static StepperMotor *_instance; // 用于静态回调
 
     // 内部方法
+    void writeStepPin(uint8_t level);
+    void writeDirPin(uint8_t level);
     void executeRotation(float revolutions);
-    void publishStatus(const char *status);
+    void enqueueMove(long stepDelta);
+    void startMove(long stepDelta);
+    void finishMotion();
+    void computeRampTable();
+    unsigned long stepIntervalMicros(long stepIndex);
+    void computePositionScale();
+    long stepsToUm(long steps) const;
+    long umToSteps(long um) const;
+    void publishStatus(const __FlashStringHelper *status);
     void publishError(const char *error);
+    void publishError(const __FlashStringHelper *error);
     void publishConfig();
     void publishPosition();
 };
@@ -0,0 +1,151 @@
+#include "TaskScheduler.h"
+
+TaskScheduler::TaskScheduler(SerialPubSub *pubsub)
+    : _pubsub(pubsub),
+      _taskCount(0),
+      _lastPublishTime(0)
+{
+}
+
+int TaskScheduler::addTask(const char *name, TaskFunction fn,
+                           unsigned long periodMs, uint8_t priority)
+{
+    if (fn == nullptr || _taskCount >= SCHEDULER_MAX_TASKS)
+    {
+        return -1;
+    }
+
+    Task &task = _tasks[_taskCount];
+    task.name = name;
+    task.fn = fn;
+    task.periodMs = periodMs;
+    task.nextDue = millis() + periodMs;
+    task.priority = priority;
+    task.missCount = 0;
+    task.maxLateMs = 0;
+    task.sumLateMs = 0;
+    task.runCount = 0;
+
+    return _taskCount++;
+}
+
+// 每轮分发：反复挑选"已到期、本轮尚未执行、优先级最高"的任务执行，
+// 直到没有到期任务为止。每个任务一轮至多执行一次，
+// 低优先级任务在高优先级任务超时的轮次会被推迟但不会饿死
+// （下一轮它的延迟更大，统计里看得到）
+void TaskScheduler::loop()
+{
+    bool ran[SCHEDULER_MAX_TASKS] = {false};
+
+    for (;;)
+    {
+        unsigned long now = millis();
+        int best = -1;
+
+        for (int i = 0; i < _taskCount; i++)
+        {
+            if (ran[i])
+            {
+                continue;
+            }
+            // 到期判断用带符号差值，对millis()溢出安全
+            if (_tasks[i].periodMs != 0 &&
+                (long)(now - _tasks[i].nextDue) < 0)
+            {
+                continue;
+            }
+            if (best < 0 || _tasks[i].priority < _tasks[best].priority)
+            {
+                best = i;
+            }
+        }
+
+        if (best < 0)
+        {
+            break;
+        }
+
+        Task &task = _tasks[best];
+        ran[best] = true;
+
+        if (task.periodMs != 0)
+        {
+            // 调度延迟 = 实际分发时刻 - 到期时刻
+            unsigned long late = now - task.nextDue;
+            task.sumLateMs += late;
+            if (late > task.maxLateMs)
+            {
+                task.maxLateMs = (late > 65535UL) ? 65535 : (uint16_t)late;
+            }
+
+            // 延迟超过一个整周期视为错过期限；到期时刻按周期网格
+            // 追赶到未来，积压的周期不补跑（跑最新的一拍即可）
+            if (late >= task.periodMs)
+            {
+                task.missCount += (unsigned int)(late / task.periodMs);
+                task.nextDue += ((late / task.periodMs) + 1) * task.periodMs;
+            }
+            else
+            {
+                task.nextDue += task.periodMs;
+            }
+        }
+
+        task.runCount++;
+        task.fn();
+    }
+
+    unsigned long now = millis();
+    if (now - _lastPublishTime >= PUBLISH_INTERVAL_MS)
+    {
+        _lastPublishTime = now;
+        publishStats();
+        resetWindow();
+    }
+}
+
+// 发布紧凑摘要：每个周期任务为 名字:延迟均值,延迟最大,错过次数（毫秒）
+// 周期为0的任务不参与（每轮执行，没有到期时刻可言）
+void TaskScheduler::publishStats()
+{
+    char payload[MAX_MESSAGE_LENGTH];
+    int pos = 0;
+
+    for (int i = 0; i < _taskCount; i++)
+    {
+        Task &task = _tasks[i];
+        if (task.periodMs == 0)
+        {
+            continue;
+        }
+
+        unsigned long mean = (task.runCount > 0)
+                                 ? (task.sumLateMs / task.runCount)
+                                 : 0;
+        int written = snprintf_P(payload + pos, sizeof(payload) - pos,
+                                 PSTR("%s%s:%lu,%u,%u"),
+                                 (pos > 0) ? ";" : "",
+                                 task.name, mean, task.maxLateMs, task.missCount);
+        if (written < 0 || pos + written >= (int)sizeof(payload))
+        {
+            break;
+        }
+        pos += written;
+    }
+
+    if (pos > 0)
+    {
+        _pubsub->publish(F("system/tasks"), payload);
+    }
+}
+
+// 清零窗口统计（错过计数持续累计，与诊断计数器口径一致）
+void TaskScheduler::resetWindow()
+{
+    for (int i = 0; i < _taskCount; i++)
+    {
+        _tasks[i].maxLateMs = 0;
+        _tasks[i].sumLateMs = 0;
+        _tasks[i].runCount = 0;
+    }
+}
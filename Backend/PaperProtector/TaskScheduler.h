@@ -0,0 +1,58 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <Arduino.h>
+#include "SerialPubSub.h"
+
+// 可注册的任务槽位数（当前注册7个，留1个给AS7341重新启用）
+#define SCHEDULER_MAX_TASKS 8
+
+typedef void (*TaskFunction)();
+
+// 协作式任务调度器
+// 取代loop()里无条件的模块调用链：模块以周期+优先级注册任务，
+// 每轮只分发到期的任务（周期为0的任务每轮都执行），
+// 同一轮内多个到期任务按优先级从高到低依次执行。
+// 周期任务记录错过整周期的次数和调度延迟（实际分发晚于到期时刻
+// 的毫秒数）的均值/最大值，按周期发布在system/tasks上，
+// 各模块的时序预算由此成为可观测的显式指标
+class TaskScheduler
+{
+public:
+    TaskScheduler(SerialPubSub *pubsub);
+
+    // 注册任务：name为2-3字符缩写，periodMs为0表示每轮执行，
+    // priority数值越小越优先；返回任务号，表满返回-1
+    int addTask(const char *name, TaskFunction fn,
+                unsigned long periodMs, uint8_t priority);
+
+    // 每轮主循环调用：分发到期任务并维护统计
+    void loop();
+
+private:
+    struct Task
+    {
+        const char *name;        // 任务缩写（指向静态字符串，不复制）
+        TaskFunction fn;
+        unsigned long periodMs;  // 执行周期，0 = 每轮执行
+        unsigned long nextDue;   // 下次到期时刻(ms)
+        uint8_t priority;        // 数值越小越优先
+        unsigned int missCount;  // 延迟超过一个整周期的次数（持续累计）
+        uint16_t maxLateMs;      // 窗口内最大调度延迟
+        unsigned long sumLateMs; // 窗口内延迟累计（求均值用）
+        unsigned int runCount;   // 窗口内执行次数
+    };
+
+    SerialPubSub *_pubsub;
+    Task _tasks[SCHEDULER_MAX_TASKS];
+    uint8_t _taskCount;
+    unsigned long _lastPublishTime;
+
+    // 统计摘要发布周期
+    static const unsigned long PUBLISH_INTERVAL_MS = 5000;
+
+    void publishStats();
+    void resetWindow();
+};
+
+#endif
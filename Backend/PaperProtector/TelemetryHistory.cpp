@@ -0,0 +1,149 @@
+#include "TelemetryHistory.h"
+
+TelemetryHistory *TelemetryHistory::_instance = nullptr;
+
+TelemetryHistory::TelemetryHistory(SerialPubSub *pubsub)
+    : _pubsub(pubsub),
+      _head(0),
+      _count(0),
+      _streaming(false),
+      _streamIndex(0),
+      _streamRemaining(0),
+      _streamCount(0)
+{
+    _instance = this;
+}
+
+void TelemetryHistory::begin()
+{
+    // 订阅表满时注册会静默失败、批量回填从此不可达，
+    // 必须上报而不是吞掉（error主题为高优先级，不经令牌桶）
+    if (!_pubsub->subscribe(F("dht/history"), historyCallback))
+    {
+        _pubsub->publish(F("dht/history/error"), F("subscribe failed"));
+    }
+}
+
+void TelemetryHistory::recordDht(int16_t temperature_x10, uint16_t humidity_x10)
+{
+    append(HISTORY_TYPE_DHT, temperature_x10, humidity_x10);
+}
+
+void TelemetryHistory::recordMoisture(uint16_t moisture_x10)
+{
+    append(HISTORY_TYPE_MOISTURE, (int16_t)moisture_x10, 0);
+}
+
+// 追加一条记录，最旧的记录被覆盖
+void TelemetryHistory::append(uint8_t type, int16_t valueA, uint16_t valueB)
+{
+    HistoryRecord &r = _records[_head];
+    r.seconds = (uint16_t)(millis() / 1000UL);
+    r.valueA = valueA;
+    r.valueB = valueB;
+    r.type = type;
+    r.reserved = 0;
+
+    _head = (_head + 1) % HISTORY_SIZE;
+    if (_count < HISTORY_SIZE)
+    {
+        _count++;
+    }
+}
+
+// 主机请求历史：只设下流式游标，数据块由loop()逐块产出。
+// 在回调里一次性突发整个环形缓冲会超出发送暂存缓冲的容量：
+// 第一块先占住暂存缓冲，第二块微秒后到达、放不下被整行丢弃，
+// 主机在end行之前只收得到前几块
+void TelemetryHistory::startStream()
+{
+    _streamIndex = (uint8_t)((_head + HISTORY_SIZE - _count) % HISTORY_SIZE);
+    _streamRemaining = _count;
+    _streamCount = _count;
+    _streaming = true;
+}
+
+// 推进进行中的回传：每轮最多产出一块，且只在发送暂存缓冲
+// 腾空后产出——一块数据行最多~150字节，暂存缓冲容得下一整行，
+// 按腾空节奏推进就不会触发整行丢弃。
+// 全部数据块发完后补发结束行dht/history/end携带总条数
+void TelemetryHistory::loop()
+{
+    if (!_streaming)
+    {
+        return;
+    }
+
+    // 上一块还没离开暂存缓冲，等下一轮
+    if (!_pubsub->txPendingEmpty())
+    {
+        return;
+    }
+
+    if (_streamRemaining == 0)
+    {
+        char endMsg[16];
+        snprintf_P(endMsg, sizeof(endMsg), PSTR("count:%u"), _streamCount);
+        _pubsub->publish(F("dht/history/end"), endMsg);
+        _streaming = false;
+        return;
+    }
+
+    emitNextChunk();
+}
+
+// 产出一行数据块：按时间先后尽量多拼记录，行满或记录耗尽为止
+// 行格式: t,<秒>,<温度x10>,<湿度x10> 或 m,<秒>,<百分比x10>，分号分隔
+void TelemetryHistory::emitNextChunk()
+{
+    char line[MAX_MESSAGE_LENGTH];
+    int pos = 0;
+
+    while (_streamRemaining > 0)
+    {
+        const HistoryRecord &r = _records[_streamIndex];
+
+        char entry[28];
+        int entryLen;
+        if (r.type == HISTORY_TYPE_DHT)
+        {
+            entryLen = snprintf_P(entry, sizeof(entry), PSTR("t,%u,%d,%u"),
+                                  r.seconds, r.valueA, r.valueB);
+        }
+        else
+        {
+            entryLen = snprintf_P(entry, sizeof(entry), PSTR("m,%u,%d"),
+                                  r.seconds, r.valueA);
+        }
+
+        // 本行放不下了，剩余记录留给下一轮
+        if (pos + entryLen + 1 >= (int)sizeof(line))
+        {
+            break;
+        }
+
+        if (pos > 0)
+        {
+            line[pos++] = ';';
+        }
+        memcpy(line + pos, entry, entryLen);
+        pos += entryLen;
+
+        _streamIndex = (_streamIndex + 1) % HISTORY_SIZE;
+        _streamRemaining--;
+    }
+
+    if (pos > 0)
+    {
+        line[pos] = '\0';
+        _pubsub->publish(F("dht/history/data"), line);
+    }
+}
+
+void TelemetryHistory::historyCallback(const char *topic, const char *payload)
+{
+    if (_instance != nullptr)
+    {
+        _instance->startStream();
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef TELEMETRY_HISTORY_H
+#define TELEMETRY_HISTORY_H
+
+#include <Arduino.h>
+#include "SerialPubSub.h"
+
+// 历史环形缓冲区容量（每条记录8字节，16条共128字节SRAM）
+#define HISTORY_SIZE 16
+
+// 记录类型
+#define HISTORY_TYPE_DHT 0
+#define HISTORY_TYPE_MOISTURE 1
+
+// 机载遥测历史
+// DHT和湿度测量的采样写入紧凑的环形缓冲区，
+// 主机重连后通过dht/history批量取回，
+// 替代断线后对dht/query和moisture/measure的轮询回填。
+// 回传是流式的：查询只设下游标，数据块由loop()按发送暂存
+// 缓冲的腾空节奏逐块产出——一次性突发整个环形缓冲会在
+// 第二块就塞满暂存缓冲，后续整行被丢弃。
+// 时间戳为开机秒数（16位，约18小时回绕），数值为x10定点整数
+class TelemetryHistory
+{
+public:
+    TelemetryHistory(SerialPubSub *pubsub);
+
+    void begin();
+
+    // 循环处理（推进进行中的历史回传）
+    void loop();
+
+    // 写入一条DHT采样（温度/湿度为实际值x10）
+    void recordDht(int16_t temperature_x10, uint16_t humidity_x10);
+
+    // 写入一条湿度测量（百分比x10）
+    void recordMoisture(uint16_t moisture_x10);
+
+private:
+    // 紧凑历史记录（8字节）
+    struct HistoryRecord
+    {
+        uint16_t seconds; // 开机秒数（回绕）
+        int16_t valueA;   // DHT: 温度x10；moisture: 百分比x10
+        uint16_t valueB;  // DHT: 湿度x10；moisture: 未使用
+        uint8_t type;     // HISTORY_TYPE_*
+        uint8_t reserved;
+    };
+
+    SerialPubSub *_pubsub;
+    HistoryRecord _records[HISTORY_SIZE];
+    uint8_t _head;  // 下一条写入位置
+    uint8_t _count; // 已写入条数（饱和于HISTORY_SIZE）
+
+    // 流式回传游标
+    bool _streaming;          // 回传是否进行中
+    uint8_t _streamIndex;     // 下一条待发记录的下标
+    uint8_t _streamRemaining; // 尚未发出的记录数
+    uint8_t _streamCount;     // 本次回传的总记录数（end行用）
+
+    void append(uint8_t type, int16_t valueA, uint16_t valueB);
+    void startStream();
+    void emitNextChunk();
+
+    static void historyCallback(const char *topic, const char *payload);
+    static TelemetryHistory *_instance;
+};
+
+#endif
@@ -325,7 +325,7 @@ def main():
     """Main entry point with argument parsing"""
     parser = argparse.ArgumentParser(description="Arduino Bridge Server")
     parser.add_argument("--port", type=str, help="Serial port (e.g., COM3 or /dev/ttyUSB0)")
-    parser.add_argument("--baudrate", type=int, help="Serial baudrate (default: 9600)")
+    parser.add_argument("--baudrate", type=int, help="Serial baudrate (default: 115200)")
     parser.add_argument("--host", type=str, default="0.0.0.0", help="WebSocket host")
     parser.add_argument("--ws-port", type=int, default=8000, help="WebSocket port")
     
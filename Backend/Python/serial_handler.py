@@ -14,13 +14,13 @@ logger = logging.getLogger(__name__)
 class SerialHandler:
     """Handles serial port communication with Arduino"""
     
-    def __init__(self, port: str, baudrate: int = 9600, timeout: float = 1.0, reconnect_interval: int = 5):
+    def __init__(self, port: str, baudrate: int = 115200, timeout: float = 1.0, reconnect_interval: int = 5):
         """
         Initialize SerialHandler
         
         Args:
             port: Serial port name (e.g., 'COM3' or '/dev/ttyUSB0')
-            baudrate: Communication speed (default: 9600)
+            baudrate: Communication speed (default: 115200)
             timeout: Read timeout in seconds
             reconnect_interval: Seconds between reconnection attempts
         """